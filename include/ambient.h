@@ -0,0 +1,53 @@
+#ifndef AMBIENT_H
+#define AMBIENT_H
+/**
+ * @file   ambient.h
+ * @author Wiktor Gołgowski <wgolgowski@gmail.com>
+ * @date   Mon Oct 19 17:20:05 2026
+ * 
+ * @brief  Ambient-adaptive display dimming. Light sensor (e.g. a
+ * photoresistor divider, brighter light gives higher voltage) is
+ * read on PA1 (ADC_IN1).
+ * 
+ */
+
+
+#include "pt6961.h"
+
+/// Time between ambient light samples.
+#define AMBIENT_PERIOD_MS 100
+
+/// Time of one brightness step while ramping.
+#define AMBIENT_FADE_MS 150
+
+/** 
+ * This function configures PA1 and the ADC. Automatic dimming stays
+ * disabled until ambient_enable is called.
+ * 
+ */
+void ambient_init(void);
+
+/** 
+ * This function turns automatic dimming on or off.
+ * 
+ * @param on non-zero enables automatic dimming
+ */
+void ambient_enable(unsigned char on);
+
+/** 
+ * This function returns whether automatic dimming is on.
+ * 
+ * @return non-zero if automatic dimming is enabled
+ */
+unsigned char ambient_enabled(void);
+
+/** 
+ * This function samples the light sensor without waiting for the
+ * ADC and ramps display brightness towards the level matching the
+ * (filtered) reading. Call it from the main loop.
+ * 
+ * @param pt pointer to PT6961 configuration structure
+ */
+void ambient_poll(PT6961_Init* pt);
+
+#endif /* AMBIENT_H */
@@ -0,0 +1,43 @@
+#ifndef COBS_H
+#define COBS_H
+/**
+ * @file   cobs.h
+ * @author Wiktor Gołgowski <wgolgowski@gmail.com>
+ * @date   Tue Oct 20 16:31:08 2026
+ * 
+ * @brief  Consistent Overhead Byte Stuffing. Encoded data has no zero
+ * bytes, so a zero delimits frames on a byte stream. Builds for the
+ * host too.
+ * 
+ */
+
+
+#include <stdint.h>
+
+/// Longest encoding of len bytes (frames up to 254 bytes).
+#define COBS_MAX(len) ((len) + 1)
+
+/** 
+ * This function encodes bytes. The delimiter is not added.
+ * 
+ * @param dst output, at least COBS_MAX(len) bytes
+ * @param src input, up to 254 bytes
+ * @param len number of input bytes
+ * 
+ * @return number of output bytes
+ */
+uint16_t cobs_encode(unsigned char* dst, const unsigned char* src, uint16_t len);
+
+/** 
+ * This function decodes a frame, without its delimiter. Decoding in
+ * place (dst == src) is allowed.
+ * 
+ * @param dst output, at least len bytes
+ * @param src encoded frame
+ * @param len number of encoded bytes
+ * 
+ * @return number of decoded bytes, 0 if the frame is malformed
+ */
+uint16_t cobs_decode(unsigned char* dst, const unsigned char* src, uint16_t len);
+
+#endif /* COBS_H */
@@ -0,0 +1,126 @@
+#ifndef COMMAND_H
+#define COMMAND_H
+/**
+ * @file   command.h
+ * @author Wiktor Gołgowski <wgolgowski@gmail.com>
+ * @date   Wed Oct 21 10:14:52 2026
+ * 
+ * @brief  Binary command protocol for a supervisory controller. Drives
+ * share the line and are told apart by address.
+ *
+ * A request is {address, code, arguments..., CRC-16}, a reply is
+ * {address, code | 0x80, status, data..., CRC-16}. Multi-byte values
+ * are little-endian, the CRC is CRC16_INIT based crc16() of the rest.
+ * Both are COBS encoded and ended by a zero byte.
+ * Requests to address 0 are executed by every drive, without reply.
+ *
+ * The parser depends on no hardware, so it builds for the host too.
+ * 
+ */
+
+
+#include <stdint.h>
+#include "cobs.h"
+
+/// Broadcast address.
+#define COMMAND_BROADCAST 0
+
+/// Longest argument or reply data.
+#define COMMAND_DATA_MAX 72
+
+/// Longest decoded frame: address, code, status, data and CRC.
+#define COMMAND_FRAME_MAX (COMMAND_DATA_MAX + 5)
+
+/// Bit set in the code of replies.
+#define COMMAND_REPLY 0x80
+
+/// Request codes.
+enum
+{
+    COMMAND_PING = 1,   /* -> version */
+    COMMAND_READ,       /* id -> value32 */
+    COMMAND_WRITE,      /* id, value32 -> value32 */
+    COMMAND_START,
+    COMMAND_STOP,       /* also clears a fault */
+    COMMAND_REVERSE,
+    COMMAND_EVENTS,     /* first16 -> count16, up to 8 events from first */
+    COMMAND_STATS       /* -> telemetry record, errors16 */
+};
+
+/// Reply status.
+enum
+{
+    COMMAND_OK,
+    COMMAND_UNKNOWN,    /* no such code */
+    COMMAND_BAD_LENGTH, /* wrong number of argument bytes */
+    COMMAND_BAD_ID,     /* no such parameter */
+    COMMAND_READ_ONLY,
+    COMMAND_RANGE       /* value out of limits */
+};
+
+/**
+ * Command handler. Gets the arguments and writes reply data, at most
+ * COMMAND_DATA_MAX bytes.
+ *
+ * @return number of reply data bytes, or minus status on error
+ */
+typedef int16_t (*CommandRun)(const unsigned char* arg, uint16_t len, unsigned char* reply);
+
+/// Handled request code, kept in const tables.
+typedef struct strCommand
+{
+    unsigned char code;
+    CommandRun run;
+} Command;
+
+/**
+ * Parser state and reply buffers. Replies alternate between two
+ * buffers, so one can be encoded while the other is sent.
+ */
+typedef struct strCommandPort
+{
+    const Command* commands;
+    unsigned char count;
+    unsigned char address;
+    unsigned char (*ready)(void); /* reply can be sent */
+    unsigned char (*send)(const unsigned char* data, uint16_t len);
+
+    unsigned char frame[COBS_MAX(COMMAND_FRAME_MAX)];
+    uint16_t len;           /* received, past the buffer if too long */
+    unsigned char pending;  /* frame complete, waits for ready */
+    unsigned char fill;
+    unsigned char reply[2][COBS_MAX(COMMAND_FRAME_MAX) + 1];
+    uint16_t errors;        /* frames dropped: length, CRC, encoding */
+} CommandPort;
+
+/**
+ * This function initializes the parser.
+ *
+ * @param port pointer to parser state
+ * @param commands table of handled codes
+ * @param count number of codes
+ * @param address address of this drive, 1-247
+ * @param ready returns non-zero if a reply can be sent now
+ * @param send sends a reply; the buffer stays valid until both
+ * buffers were used again
+ */
+void command_init(CommandPort* port, const Command* commands, unsigned char count,
+                  unsigned char address,
+                  unsigned char (*ready)(void),
+                  unsigned char (*send)(const unsigned char* data, uint16_t len));
+
+/**
+ * This function parses received bytes and handles complete requests.
+ * It never blocks: a request waiting for the transmitter stops the
+ * parser and the rest of the bytes are left to the caller. Call it
+ * also with no new bytes, to retry such a request.
+ *
+ * @param port pointer to parser state
+ * @param data received bytes
+ * @param len number of bytes
+ *
+ * @return number of bytes used
+ */
+uint16_t command_feed(CommandPort* port, const unsigned char* data, uint16_t len);
+
+#endif /* COMMAND_H */
@@ -0,0 +1,75 @@
+#ifndef CORO_H
+#define CORO_H
+/**
+ * @file   coro.h
+ * @author Wiktor Gołgowski <wgolgowski@gmail.com>
+ * @date   Mon Oct 19 21:47:30 2026
+ *
+ * @brief  Stackless coroutines (protothreads) over switch/case.
+ *
+ * A coroutine is a function returning CORO_WAITING or CORO_DONE, with
+ * its body between CORO_BEGIN and CORO_END. Waits return to the caller
+ * and the next call resumes at the same place, so a sequence is
+ * written linearly but yields to the scheduler. Local variables are
+ * not kept over waits, use statics or the owner structure. The body
+ * must not contain its own switch around a wait, and each wait must be
+ * on its own source line.
+ *
+ * Only CORO_WAIT_MS needs the tick of delay.h, so coroutines without
+ * timed waits build for the host too.
+ *
+ */
+
+
+#include <stdint.h>
+
+/// Values returned by coroutine functions.
+enum
+{
+    CORO_WAITING,
+    CORO_DONE
+};
+
+/// Coroutine state, zero (or CORO_INIT) starts from the beginning.
+typedef struct strCoro
+{
+    uint16_t line;      /* resume point */
+    uint32_t until;     /* end of CORO_WAIT_MS, a deadline_t */
+} Coro;
+
+#define CORO_INIT(c) ((c)->line = 0)
+
+#define CORO_BEGIN(c) switch((c)->line) { case 0:
+
+/// Returns once, the next call continues after it.
+#define CORO_YIELD(c)                             \
+    do                                            \
+    {                                             \
+        (c)->line = __LINE__;                     \
+        return CORO_WAITING;                      \
+    case __LINE__:;                               \
+    } while(0)
+
+/// Returns until the condition holds, it is checked on every call.
+#define CORO_WAIT_UNTIL(c, cond)                  \
+    do                                            \
+    {                                             \
+        (c)->line = __LINE__;                     \
+    case __LINE__:                                \
+        if(!(cond))                               \
+            return CORO_WAITING;                  \
+    } while(0)
+
+/// Returns until at least given number of milliseconds passed, the
+/// caller includes delay.h.
+#define CORO_WAIT_MS(c, ms)                                   \
+    do                                                        \
+    {                                                         \
+        (c)->until = deadline_in((ms) + 1);                   \
+        CORO_WAIT_UNTIL(c, deadline_expired((c)->until));     \
+    } while(0)
+
+/// Ends the body, the next call starts the coroutine again.
+#define CORO_END(c) } (c)->line = 0; return CORO_DONE
+
+#endif /* CORO_H */
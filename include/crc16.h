@@ -0,0 +1,30 @@
+#ifndef CRC16_H
+#define CRC16_H
+/**
+ * @file   crc16.h
+ * @author Wiktor Gołgowski <wgolgowski@gmail.com>
+ * @date   Tue Oct 20 16:31:08 2026
+ * 
+ * @brief  CRC-16/CCITT (polynomial 0x1021, MSB first). Builds for the
+ * host too.
+ * 
+ */
+
+
+#include <stdint.h>
+
+/// Initial value of the CRC.
+#define CRC16_INIT 0xFFFF
+
+/** 
+ * This function continues a CRC over given bytes.
+ * 
+ * @param crc CRC so far, CRC16_INIT at start
+ * @param data bytes
+ * @param len number of bytes
+ * 
+ * @return updated CRC
+ */
+uint16_t crc16(uint16_t crc, const unsigned char* data, uint16_t len);
+
+#endif /* CRC16_H */
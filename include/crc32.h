@@ -0,0 +1,55 @@
+#ifndef CRC32_H
+#define CRC32_H
+/**
+ * @file   crc32.h
+ * @author Wiktor Gołgowski <wgolgowski@gmail.com>
+ * @date   Thu Oct 22 11:05:39 2026
+ * 
+ * @brief  CRC-32 (as in zlib, polynomial 0x04C11DB7 reflected) on the
+ * CRC unit, with DMA for large blocks. Built with CRC32_SOFTWARE, e.g.
+ * for host tools, it is computed a nibble at a time instead.
+ *
+ * The CRC unit has one state, so one computation runs at a time and
+ * it is not used from interrupts.
+ * 
+ */
+
+
+#include <stdint.h>
+
+/// Blocks from this many bytes are fed to the CRC unit by DMA.
+#define CRC32_DMA_MIN 64
+
+/** 
+ * This function starts a new CRC.
+ * 
+ */
+void crc32_start(void);
+
+/** 
+ * This function continues the CRC over given bytes. Data of any
+ * alignment and length is accepted.
+ * 
+ * @param data bytes
+ * @param len number of bytes
+ */
+void crc32_update(const void* data, uint32_t len);
+
+/** 
+ * This function returns the CRC of all bytes since crc32_start.
+ * 
+ * @return CRC
+ */
+uint32_t crc32_result(void);
+
+/** 
+ * This function computes the CRC of one block.
+ * 
+ * @param data bytes
+ * @param len number of bytes
+ * 
+ * @return CRC
+ */
+uint32_t crc32(const void* data, uint32_t len);
+
+#endif /* CRC32_H */
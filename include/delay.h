@@ -1,9 +1,88 @@
 #ifndef DELAY_H
 #define DELAY_H
+/**
+ * @file   delay.h
+ * @author Wiktor Gołgowski <wgolgowski@gmail.com>
+ * @date   Mon Oct 19 20:11:05 2026
+ *
+ * @brief  Millisecond tick, calibrated busy waits and deadlines.
+ *
+ */
+
 
 #include "stm32f0xx.h"
 
+/// Point in time, in ticks (milliseconds). Compare with deadline_expired.
+typedef uint32_t deadline_t;
+
 void DelayMs_Decrement(void);
 void DelayMs(__IO uint32_t ms);
+uint32_t tick_get(void);
+
+/**
+ * This function advances the millisecond tick. It is called from the
+ * SysTick interrupt, which comes later than every millisecond after
+ * tick_sleep.
+ *
+ * @return milliseconds elapsed since the previous call
+ */
+uint32_t tick_increment(void);
+
+/**
+ * This function sleeps in WFI for at most given number of ticks, or
+ * until an interrupt. For more than one tick the SysTick is
+ * reprogrammed to fire only at the end, and the tick is corrected on
+ * an earlier wake-up. It must be called with interrupts disabled,
+ * after the last check for pending work, so a wake-up interrupt in
+ * between is not lost. Interrupts are enabled on return.
+ *
+ * @param ms ticks to sleep, limited by the SysTick counter range
+ *
+ * @return approximate cycles slept (interrupt handlers included)
+ */
+uint32_t tick_sleep(uint32_t ms);
+
+/**
+ * This function returns current time in core clock cycles, built from
+ * the millisecond tick and the SysTick down-counter.
+ *
+ * @return timestamp in cycles, wraps around
+ */
+uint32_t cycle_get(void);
+
+/**
+ * This function busy waits given number of core clock cycles, measured
+ * with the SysTick counter, so the time does not depend on clock
+ * settings nor optimisation level. Interrupts only make it longer.
+ *
+ * @param cycles cycles to wait
+ */
+void delay_cycles(uint32_t cycles);
+
+/**
+ * This function busy waits given number of microseconds.
+ *
+ * @param us microseconds to wait
+ */
+void delay_us(uint32_t us);
+
+/**
+ * This function returns a deadline given time from now.
+ *
+ * @param ms milliseconds from now
+ *
+ * @return deadline
+ */
+deadline_t deadline_in(uint32_t ms);
+
+/**
+ * This function checks a deadline without waiting, so the caller can
+ * do other work until it passes. Wrap-around of the tick is handled.
+ *
+ * @param deadline deadline to check
+ *
+ * @return 1 if the deadline has passed, 0 otherwise
+ */
+unsigned char deadline_expired(deadline_t deadline);
 
 #endif /* DELAY_H */
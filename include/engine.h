@@ -0,0 +1,73 @@
+#ifndef ENGINE_H
+#define ENGINE_H
+/**
+ * @file   engine.h
+ * @author Wiktor Gołgowski <wgolgowski@gmail.com>
+ * @date   Thu Oct 22 15:22:10 2026
+ * 
+ * @brief  Six-step commutation of one or more drives. Each drive has
+ * its own state and pin map; drives are kept in an array, so the tick
+ * walks contiguous memory. The control state machine is in
+ * engine_fsm.h.
+ * 
+ */
+
+
+#include "stm32f0xx.h"
+#include "gpiopin.h"
+#include "engine_fsm.h"
+
+/// Pins of one drive, kept in const tables.
+typedef struct strEnginePins
+{
+    GPIOPin out[ENGINE_PHASES]; /* transistors, bit n of the phase pattern */
+    GPIOPin fault;              /* overcurrent input, active high, pulled up */
+} EnginePins;
+
+/** 
+ * This function drives the outputs of a drive low. It uses no
+ * variables, so it can run before RAM is initialized.
+ * 
+ * @param pins pin map, in flash
+ */
+void engine_pins_safe(const EnginePins* pins);
+
+/** 
+ * This function resets a drive to ENGINE_INIT and configures its
+ * pins. The requested rotation and direction may be set before the
+ * first engine_handle.
+ * 
+ * @param engine pointer to drive state
+ * @param pins pin map, outputs on at most ENGINE_PORTS ports
+ */
+void engine_init(Engine* engine, const EnginePins* pins);
+
+/** 
+ * This function advances the phase of every drive whose phase time
+ * elapsed. It is called from SysTick every millisecond.
+ * 
+ * @param drives array of drives
+ * @param count number of drives
+ */
+void engine_tick(Engine* drives, unsigned char count);
+
+/** 
+ * This function drives the outputs to the current phase, or off if
+ * the drive is not rotating. Each port is written once.
+ * 
+ * @param engine pointer to drive state
+ * 
+ * @return 1 if the pattern changed
+ */
+unsigned char engine_output(Engine* engine);
+
+/** 
+ * This function reads the overcurrent input.
+ * 
+ * @param engine pointer to drive state
+ * 
+ * @return non-zero on fault
+ */
+unsigned char engine_fault(const Engine* engine);
+
+#endif /* ENGINE_H */
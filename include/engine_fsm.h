@@ -0,0 +1,99 @@
+#ifndef ENGINE_FSM_H
+#define ENGINE_FSM_H
+/**
+ * @file   engine_fsm.h
+ * @author Wiktor Gołgowski <wgolgowski@gmail.com>
+ * @date   Fri Oct 23 10:37:15 2026
+ *
+ * @brief  State of one drive and its control state machine. Nothing
+ * here touches the hardware, so it builds for the host too; pins and
+ * outputs are in engine.h.
+ *
+ */
+
+
+#include <stdint.h>
+#include "coro.h"
+
+/// Commutation steps per electrical revolution.
+#define ENGINE_PHASES 6
+
+/// Ports the outputs of one drive may use.
+#define ENGINE_PORTS 2
+
+/// Calls of engine_handle per rpm step when ramping or braking. It is
+/// called every millisecond, so 0 to 1000 rpm takes 2 s.
+#define ENGINE_RAMP_STEPS 2
+
+/// Drive states. Values are reported by telemetry and Modbus.
+enum
+{
+    ENGINE_INIT,        /* setpoint loaded, outputs not set up yet */
+    ENGINE_READY,       /* stopped, waits for START */
+    ENGINE_RUNNING,     /* ramps to the requested rotation */
+    ENGINE_STOPPED,     /* fault tripped, one step before READY */
+    ENGINE_REVERSING,   /* brakes, flips direction, then runs again */
+    ENGINE_STATES
+};
+
+/// Drive events. All but ENGINE_EV_FAULT come from engine_event.
+enum
+{
+    ENGINE_EV_RUN,      /* started, no fault */
+    ENGINE_EV_STOP,     /* not started or fault latched */
+    ENGINE_EV_REVERSE,  /* requested direction differs */
+    ENGINE_EV_FAULT,    /* overcurrent input tripped */
+    ENGINE_EVENTS
+};
+
+struct strEnginePins;
+
+/// State of one drive.
+typedef struct strEngine
+{
+    /* Used by engine_tick every millisecond, kept first. */
+    volatile uint32_t phase_counter; /* ms to the next phase */
+    uint32_t duration;           /* ms per phase */
+    volatile unsigned char phase; /* 0-5, 60° phase */
+    unsigned char direction;     /* 1 - right, 0 - left */
+
+    unsigned char requested_direction;
+    unsigned char started;
+    unsigned char fault_overcurrent;
+    unsigned char pattern;       /* driven phase, ENGINE_PHASES if off */
+    unsigned char state;         /* ENGINE_INIT... */
+    unsigned char ramp_counter;  /* calls since the last rpm step */
+    uint32_t rotation;
+    uint32_t requested_rotation;
+
+    Coro reverse;
+    uint32_t rotation_before_reverse;
+
+    /* Output words per phase and port, the last row is all off. */
+    volatile uint32_t* port_bsrr[ENGINE_PORTS]; /* 0 if unused */
+    uint32_t bsrr[ENGINE_PHASES + 1][ENGINE_PORTS];
+    const struct strEnginePins* pins;
+} Engine;
+
+/**
+ * This function derives the event of the current inputs: requested
+ * direction, started flag and fault latch.
+ *
+ * @param engine pointer to drive state
+ *
+ * @return ENGINE_EV_RUN, ENGINE_EV_STOP or ENGINE_EV_REVERSE
+ */
+unsigned char engine_event(const Engine* engine);
+
+/**
+ * This function makes one transition of the state machine: looks up
+ * the state and event in a const table, runs the action and sets the
+ * next state. The commutation period is recomputed only when the
+ * rotation changes.
+ *
+ * @param engine pointer to drive state
+ * @param event ENGINE_EV_...
+ */
+void engine_handle(Engine* engine, unsigned char event);
+
+#endif /* ENGINE_FSM_H */
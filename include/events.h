@@ -0,0 +1,89 @@
+#ifndef EVENTS_H
+#define EVENTS_H
+/**
+ * @file   events.h
+ * @author Wiktor Gołgowski <wgolgowski@gmail.com>
+ * @date   Tue Oct 20 11:40:26 2026
+ * 
+ * @brief  Event log for post-mortem diagnostics, kept in the EVENTS
+ * flash region of the linker script.
+ * 
+ */
+
+
+#include "stm32f0xx.h"
+
+/// Events are kept in RAM until this many are pending.
+#define EVENTS_BATCH 4
+
+/// Size of the RAM ring (survives resets, not power loss).
+#define EVENTS_RAM 16
+
+/// Event types.
+enum
+{
+    EVENT_RESET = 1,     /* boot, info is the reset reason */
+    EVENT_OVERCURRENT,   /* fault input tripped */
+    EVENT_FAULT_CLEARED, /* fault acknowledged with STOP */
+    EVENT_IMAGE_CRC      /* firmware image checksum mismatch at boot */
+};
+
+/** 
+ * Sink for events_dump, e.g. a serial port.
+ * 
+ * @param data bytes to send
+ * @param len number of bytes
+ */
+typedef void (*EventSink)(const unsigned char* data, uint16_t len);
+
+/** 
+ * This function finds the log in flash and takes over events left in
+ * the RAM ring by a reset.
+ * 
+ */
+void events_init(void);
+
+/** 
+ * This function adds an event with current tick as timestamp. If the
+ * RAM ring is full, the oldest event not being written to flash is
+ * lost, so the new one is always kept.
+ * 
+ * @param type event type
+ * @param info type specific byte, e.g. engine state and phase
+ * @param value type specific value, e.g. rotation
+ */
+void events_log(unsigned char type, unsigned char info, uint16_t value);
+
+/** 
+ * This function does one step of flushing: programs one half-word, or
+ * erases the older page when the current one is full. Flushing starts
+ * when EVENTS_BATCH events are pending, or any when quiet.
+ * 
+ * @param quiet 1 if a page may be erased now (e.g. motor stopped)
+ */
+void events_poll(unsigned char quiet);
+
+/** 
+ * This function returns the number of events kept (flash and RAM).
+ * 
+ * @return number of events
+ */
+uint16_t events_count(void);
+
+/** 
+ * This function returns the type of the newest event.
+ * 
+ * @return event type, zero if the log is empty
+ */
+unsigned char events_last(void);
+
+/** 
+ * This function sends the log, oldest first: header 'E', 1, count
+ * (16-bit), then 8 bytes per event: type, info, value (16-bit),
+ * timestamp in ms since its boot (32-bit), all little-endian.
+ * 
+ * @param sink function receiving the bytes
+ */
+void events_dump(EventSink sink);
+
+#endif /* EVENTS_H */
@@ -0,0 +1,39 @@
+#ifndef FLASH_H
+#define FLASH_H
+/**
+ * @file   flash.h
+ * @author Wiktor Gołgowski <wgolgowski@gmail.com>
+ * @date   Tue Oct 20 09:12:44 2026
+ * 
+ * @brief  Programming of the internal flash. The CPU stalls on flash
+ * reads while an operation is in progress, interrupts included.
+ * 
+ */
+
+
+#include "stm32f0xx.h"
+
+/// Erase unit of the STM32F051 flash.
+#define FLASH_PAGE_SIZE 1024
+
+/** 
+ * This function programs one half-word, which takes tens of
+ * microseconds. The location must be erased, 0xFFFF is skipped.
+ * 
+ * @param addr half-word address in flash
+ * @param value value to program
+ * 
+ * @return 1 on success, 0 on error
+ */
+unsigned char flash_program(uint16_t* addr, uint16_t value);
+
+/** 
+ * This function erases one page, which takes tens of milliseconds.
+ * 
+ * @param page address of the page start
+ * 
+ * @return 1 on success, 0 on error
+ */
+unsigned char flash_erase(uint16_t* page);
+
+#endif /* FLASH_H */
@@ -0,0 +1,47 @@
+#ifndef JITTER_H
+#define JITTER_H
+/**
+ * @file   jitter.h
+ * @author Wiktor Gołgowski <wgolgowski@gmail.com>
+ * @date   Mon Oct 19 14:30:17 2026
+ *
+ * @brief  Commutation edge jitter statistics.
+ *
+ */
+
+
+#include "stm32f0xx.h"
+
+/**
+ * Number of histogram bins. Bin 0 counts edges switched exactly on
+ * time, bin n counts deviations from 2^(n-1) to 2^n - 1 microseconds,
+ * the last bin collects everything above.
+ */
+#define JITTER_BINS 16
+
+/// Statistics kept in RAM, readable with the debugger.
+typedef struct strJitterStats
+{
+    uint32_t bins[JITTER_BINS];
+    uint32_t samples;
+    uint32_t worst_us; /* worst deviation seen since last reset */
+} JitterStats;
+
+extern JitterStats jitter;
+
+/**
+ * This function clears the histogram and the worst-case value.
+ *
+ */
+void jitter_reset(void);
+
+/**
+ * This function timestamps a change of the output phase pattern and
+ * accumulates its deviation from the scheduled period. Edge pairs
+ * with different scheduled periods are not compared.
+ *
+ * @param period_ms scheduled phase period, zero if motor is stopped
+ */
+void jitter_edge(uint32_t period_ms);
+
+#endif /* JITTER_H */
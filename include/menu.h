@@ -0,0 +1,118 @@
+#ifndef MENU_H
+#define MENU_H
+/**
+ * @file   menu.h
+ * @author Wiktor Gołgowski <wgolgowski@gmail.com>
+ * @date   Mon Oct 19 16:02:41 2026
+ *
+ * @brief  Table-driven menu engine for the PT6961 display and keypad.
+ *
+ */
+
+
+#include "pt6961.h"
+
+/// Blink period of edited page label.
+#define MENU_BLINK_MS 300
+
+/// Ways of showing page value.
+enum
+{
+    MENU_FMT_INT,       /* integer */
+    MENU_FMT_FIXED1,    /* fixed-point, one decimal place */
+    MENU_FMT_DIRECTION  /* 'r' for non-zero, 'l' for zero */
+};
+
+/// Ways of editing page value.
+enum
+{
+    MENU_EDIT_NONE,     /* read only, OK calls commit with current value */
+    MENU_EDIT_STEP,     /* UP/DOWN change value by step within limits */
+    MENU_EDIT_TOGGLE    /* UP/DOWN toggle between zero and one */
+};
+
+/**
+ * Single menu page. Pages are kept in const tables, so they live in
+ * flash. Page number shown on the display is its index in the group.
+ */
+typedef struct strMenuPage
+{
+    int32_t (*get)(void);          /* value getter */
+    void (*commit)(int32_t value); /* called on OK, may be 0 */
+    int32_t min;
+    int32_t max;
+    uint16_t step;
+    unsigned char format;
+    unsigned char editor;
+} MenuPage;
+
+/// Group of pages sharing the mode character, e.g. display or program.
+typedef struct strMenuGroup
+{
+    const MenuPage* pages;
+    unsigned char count;
+    char label;        /* mode character */
+    char alert_label;  /* mode character used while alert is raised */
+} MenuGroup;
+
+/**
+ * Menu state. Last rendered state is kept, so the display is sent
+ * only when something visible changes.
+ */
+typedef struct strMenu
+{
+    const MenuGroup* groups;
+    unsigned char group_count;
+    unsigned char group;
+    unsigned char page;
+    unsigned char editing;
+    unsigned char alert;
+    int32_t edit_value;
+
+    unsigned char shown; /* zero forces next render */
+    unsigned char shown_group;
+    unsigned char shown_page;
+    unsigned char shown_flags;
+    int32_t shown_value;
+} Menu;
+
+/**
+ * This function sets the menu to the first page of the first group.
+ *
+ * @param menu pointer to menu state
+ * @param groups table of page groups
+ * @param group_count number of groups
+ */
+void menu_init(Menu* menu, const MenuGroup* groups, unsigned char group_count);
+
+/**
+ * This function forces the next menu_render to send the display,
+ * e.g. after something else was shown on it.
+ *
+ * @param menu pointer to menu state
+ */
+void menu_invalidate(Menu* menu);
+
+/**
+ * This function handles a key press. UP/DOWN select page or change
+ * edited value, OK starts editing or commits, ESC switches to the
+ * next group (or cancels editing).
+ *
+ * @param menu pointer to menu state
+ * @param key key code
+ *
+ * @return 1 if the key was used, 0 otherwise
+ */
+unsigned char menu_key(Menu* menu, unsigned char key);
+
+/**
+ * This function shows the current page, if the value or the page
+ * changed since last call. Label of edited page blinks by display
+ * effects, so blinking itself does not need rendering.
+ *
+ * @param menu pointer to menu state
+ * @param pt pointer to PT6961 configuration structure
+ */
+void menu_render(Menu* menu, PT6961_Init* pt);
+
+#endif /* MENU_H */
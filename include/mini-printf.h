@@ -33,9 +33,23 @@
 
 #include <stdarg.h>
 
+/*
+ * Supported conversions: %d %u %x %X %c %s and %q, with optional
+ * '-' (left alignment) and '0' (zero padding) flags and field width.
+ * %q prints an integer as fixed-point number, precision gives the
+ * number of implied decimal places (default 1): "%5.2q" of 1235 gives
+ * "12.35". A number not fitting in the buffer is replaced by '-'.
+ */
 int mini_vsnprintf(char* buffer, unsigned int buffer_len, char *fmt, va_list va);
 int mini_snprintf(char* buffer, unsigned int buffer_len, char *fmt, ...);
 
+/*
+ * Divides by ten without the library division, which is slow on
+ * Cortex-M0 (no hardware divider). Returns n / 10, the remainder is
+ * stored in *rem.
+ */
+unsigned int mini_divu10(unsigned int n, unsigned int *rem);
+
 #define vsnprintf mini_vsnprintf
 #define snprintf mini_snprintf
 
@@ -0,0 +1,91 @@
+#ifndef MODBUS_H
+#define MODBUS_H
+/**
+ * @file   modbus.h
+ * @author Wiktor Gołgowski <wgolgowski@gmail.com>
+ * @date   Wed Oct 21 15:40:27 2026
+ * 
+ * @brief  Modbus RTU slave: holding and input registers mapped by
+ * tables of getters and setters. Functions 03, 04, 06 and 16 are
+ * handled. Frame timing is done by rtu.c, so this builds for the
+ * host too.
+ * 
+ */
+
+
+#include <stdint.h>
+
+/**
+ * Longest RTU frame, with address and CRC. The specification allows
+ * 256 bytes, but the register tables are short and a frame must fit
+ * the serial receive ring. Reads and writes of more registers than
+ * fit are refused with MODBUS_ILLEGAL_VALUE.
+ */
+#define MODBUS_ADU_MAX 64
+
+/// Exception codes.
+enum
+{
+    MODBUS_ILLEGAL_FUNCTION = 1,
+    MODBUS_ILLEGAL_ADDRESS,
+    MODBUS_ILLEGAL_VALUE
+};
+
+/// Register, kept in const tables. Address is the index in the table.
+typedef struct strModbusRegister
+{
+    uint16_t (*get)(void);
+    unsigned char (*set)(uint16_t value); /* 0 rejects the value, may be 0 */
+} ModbusRegister;
+
+/// Slave state.
+typedef struct strModbusSlave
+{
+    const ModbusRegister* holding;
+    uint16_t holding_count;
+    const ModbusRegister* input;
+    uint16_t input_count;
+    unsigned char address;  /* 1-247 */
+    uint16_t errors;        /* frames with bad length or CRC */
+} ModbusSlave;
+
+/** 
+ * This function initializes the slave.
+ * 
+ * @param slave pointer to slave state
+ * @param holding holding registers, read and written
+ * @param holding_count number of holding registers
+ * @param input input registers, read only
+ * @param input_count number of input registers
+ * @param address slave address, 1-247
+ */
+void modbus_init(ModbusSlave* slave, const ModbusRegister* holding, uint16_t holding_count,
+                 const ModbusRegister* input, uint16_t input_count, unsigned char address);
+
+/** 
+ * This function computes the Modbus CRC (polynomial 0xA001, reflected,
+ * initial value 0xFFFF). It is sent low byte first.
+ * 
+ * @param data bytes
+ * @param len number of bytes
+ * 
+ * @return CRC
+ */
+uint16_t modbus_crc(const unsigned char* data, uint16_t len);
+
+/** 
+ * This function handles a complete request and builds the reply.
+ * Requests to other slaves and broadcasts are not answered. Requests
+ * longer than MODBUS_ADU_MAX are counted as errors without reading
+ * them, so len may exceed the request buffer.
+ * 
+ * @param slave pointer to slave state
+ * @param req request, with address and CRC
+ * @param len number of request bytes
+ * @param reply output, MODBUS_ADU_MAX bytes
+ * 
+ * @return number of reply bytes with CRC, 0 if none
+ */
+uint16_t modbus_frame(ModbusSlave* slave, const unsigned char* req, uint16_t len, unsigned char* reply);
+
+#endif /* MODBUS_H */
@@ -0,0 +1,63 @@
+#ifndef PARAMS_H
+#define PARAMS_H
+/**
+ * @file   params.h
+ * @author Wiktor Gołgowski <wgolgowski@gmail.com>
+ * @date   Tue Oct 20 09:12:44 2026
+ * 
+ * @brief  Parameters kept over power cycles, in the last two flash
+ * pages (PARAMS region of the linker script).
+ * 
+ */
+
+
+#include "stm32f0xx.h"
+
+/// Stored parameters. Parameters never written read as zero.
+enum
+{
+    PARAM_SELECTED_ROTATION,
+    PARAM_SELECTED_DIRECTION,
+    PARAM_REQUESTED_ROTATION,
+    PARAM_REQUESTED_DIRECTION,
+    PARAM_TELEMETRY_MS,         /* unused, keeps the ids of stored records */
+    PARAM_ADDRESS,
+    PARAM_COUNT
+};
+
+/** 
+ * This function finds the current page and loads the last valid
+ * value of every parameter into the RAM cache.
+ * 
+ */
+void params_init(void);
+
+/** 
+ * This function returns a parameter from the RAM cache.
+ * 
+ * @param id parameter
+ * 
+ * @return value, zero if unknown
+ */
+int32_t params_get(unsigned char id);
+
+/** 
+ * This function changes a parameter in the RAM cache. Changed value
+ * is written to flash later by params_poll.
+ * 
+ * @param id parameter
+ * @param value new value
+ */
+void params_set(unsigned char id, int32_t value);
+
+/** 
+ * This function does one step of pending flash work: programs one
+ * half-word, or erases a page if the current one is full. Erasing
+ * stalls the CPU for tens of milliseconds, so it is only done when
+ * allowed.
+ * 
+ * @param quiet 1 if a page may be erased now (e.g. motor stopped)
+ */
+void params_poll(unsigned char quiet);
+
+#endif /* PARAMS_H */
@@ -11,10 +11,42 @@
 
 
 #include "gpiopin.h"
+#include "coro.h"
 
 /// Six characters available for display.
 #define PT_LEN 6 
 
+/// Display string length, each character may be followed by a point.
+#define PT_VALUE_LEN (2*PT_LEN)
+
+/// Digit mask selecting the whole display.
+#define PT_ALL_DIGITS ((1 << PT_LEN) - 1)
+
+/// Brightness levels of the display control command.
+#define PT_BRIGHTNESS_MAX 7
+
+/// Time between key scans on a shared bus, one chip per scan.
+#define PT_SCAN_MS 10
+
+/**
+ * Indicator LED, given by grid (digit) and bit of the second display
+ * RAM byte of that grid (segments 9 - 12).
+ */
+#define PT_LED(grid, bit) (((grid) << 3) | (bit))
+
+/// Status LEDs wired to the extra segment lines.
+enum
+{
+    PT_LED_RUNNING = PT_LED(0, 0),
+    PT_LED_FAULT = PT_LED(1, 0),
+    PT_LED_DIRECTION = PT_LED(2, 0), /* lit for right */
+    PT_LED_PROGRAM = PT_LED(3, 0)
+};
+
+/// Parts of the display RAM waiting for pt6961_bus_flush.
+#define PT_DIRTY_SEG 0x01
+#define PT_DIRTY_IND 0x02
+
 /** 
  * This structure keeps information about GPIO connections and
  * currently displayed value. Also, it could be initialized with
@@ -23,6 +55,7 @@
  */
 
 struct strPT6961_Init;
+struct strPT6961_Bus;
 
 /// Type of function pointer, which must be defined to receive button calls.
 typedef unsigned char (*pt_keyhandler)(struct strPT6961_Init*, unsigned char key);
@@ -33,10 +66,45 @@ typedef struct strPT6961_Init
     GPIOPin DOUT;
     GPIOPin CLK;
     GPIOPin STB;
-    unsigned char value[PT_LEN+1];
+    unsigned char value[PT_VALUE_LEN+1];
+    unsigned char seg[PT_LEN]; /* segment framebuffer, one byte per digit */
+    unsigned char ind[PT_LEN]; /* indicator LEDs, second byte of each digit */
     pt_keyhandler handler;
+
+    /* Effects state, see pt6961_blink, pt6961_fade. */
+    unsigned char display_on; /* see pt6961_on, pt6961_off */
+    unsigned char brightness; /* current level, 0 - PT_BRIGHTNESS_MAX */
+    unsigned char fade_target; /* level the fade goes to */
+    unsigned char blink_mask; /* blinking digits, bit 0 is the leftmost */
+    unsigned char blank; /* blink phase, masked digits are off */
+    uint16_t blink_ms; /* half of the blink period */
+    uint16_t fade_ms; /* time of one fade step */
+    uint32_t blink_next; /* tick of next blink transition */
+    uint32_t fade_next; /* tick of next fade step */
+
+    /* Shared bus, must be set (or zero) before pt6961_start. */
+    struct strPT6961_Bus* bus; /* 0 if the chip has its own pins */
+    unsigned char dirty; /* PT_DIRTY_SEG, PT_DIRTY_IND */
+    __IO unsigned char key; /* key found by bus scan, 0 if none */
+    Coro start; /* state of pt6961_start */
 } PT6961_Init;
 
+/**
+ * Several chips may share CLK, DIN and DOUT lines, each with its own
+ * STB. Transfers on a shared bus are arbitrated, so a key scan from
+ * the SysTick interrupt never interleaves with a display write from
+ * the main loop; the scan is skipped and retried instead.
+ * Framebuffer refreshes of chips on a bus are batched.
+ */
+typedef struct strPT6961_Bus
+{
+    PT6961_Init** chips;
+    unsigned char count;
+    unsigned char scan_next; /* chip to scan next */
+    uint16_t scan_timer; /* ms to next scan */
+    __IO unsigned char busy; /* transfer in progress */
+} PT6961_Bus;
+
 /**
  * Six keys with codes defined. The last one acts as terminator, if
  * no key is read.
@@ -53,12 +121,32 @@ enum
 };
 
 /** 
- * This function initializes the display, but keeps it turned off.
+ * This function computes bus timing for current SystemCoreClock, so
+ * the bus runs as fast as the PT6961 allows. It is called by
+ * pt6961_start, call it again after changing the core clock.
+ * 
+ */
+void pt6961_timing(void);
+
+/** 
+ * This function initializes the display and turns it on. It waits
+ * for the chip power-up, see pt6961_start for a non-blocking way.
  * 
  * @param pt pointer to PT6961 configuration structure
  */
 void pt6961_init(PT6961_Init* pt);
 
+/** 
+ * This function initializes the display as a coroutine, it returns
+ * while the chip powers up or the shared bus is busy. Call it until
+ * it returns CORO_DONE, start field must be zeroed (CORO_INIT) first.
+ * 
+ * @param pt pointer to PT6961 configuration structure
+ * 
+ * @return CORO_DONE when the display is initialized and on
+ */
+unsigned char pt6961_start(PT6961_Init* pt);
+
 /** 
  * This function sends a single byte to the display.
  * 
@@ -69,12 +157,86 @@ void pt6961_send(PT6961_Init* pt, unsigned char data);
 
 /** 
  * This function refreshes the display, using the string kept in the
- * configuration structure.
+ * configuration structure. A '.' is shown as decimal point of the
+ * preceding character.
  * 
  * @param pt pointer to PT6961 configuration structure
  */
 void pt6961_update(PT6961_Init* pt);
 
+/** 
+ * This function sends the segment framebuffer to the display. For a
+ * chip on a shared bus, it is only marked to be sent by
+ * pt6961_bus_flush.
+ * 
+ * @param pt pointer to PT6961 configuration structure
+ */
+void pt6961_refresh(PT6961_Init* pt);
+
+/** 
+ * This function sends given segment bytes to the display, bypassing
+ * the framebuffer. Used by the scrolling viewport, which moves a
+ * pointer over pre-converted text.
+ * 
+ * @param pt pointer to PT6961 configuration structure
+ * @param seg PT_LEN segment bytes
+ */
+void pt6961_show_segments(PT6961_Init* pt, const unsigned char* seg);
+
+/** 
+ * This function converts a string into segment bytes. A '.' or ','
+ * lights the decimal point of the preceding character instead of
+ * taking a position of its own.
+ * 
+ * @param seg output buffer
+ * @param len size of the output buffer
+ * @param str string to convert
+ * 
+ * @return number of positions used
+ */
+unsigned char pt6961_convert(unsigned char* seg, unsigned char len, const char* str);
+
+/** 
+ * This function turns a status LED on or off. Only changes are sent,
+ * and only the indicator bytes, so digits are left untouched.
+ * 
+ * @param pt pointer to PT6961 configuration structure
+ * @param led PT_LED_RUNNING, PT_LED_FAULT, ... or PT_LED(grid, bit)
+ * @param on non-zero lights the LED
+ */
+void pt6961_indicator(PT6961_Init* pt, unsigned char led, unsigned char on);
+
+/** 
+ * This function shows a fixed-point number, converting it directly
+ * into the segment framebuffer. The prefix is placed on the left, the
+ * number is right aligned with leading digits blanked. If the number
+ * does not fit, its field is filled with dashes.
+ * 
+ * @param pt pointer to PT6961 configuration structure
+ * @param prefix text shown on the left (e.g. mode and page), may be 0
+ * @param value number to show, scaled by 10^decimals
+ * @param decimals digits shown after the decimal point
+ */
+void pt6961_show_fixed(PT6961_Init* pt, const char* prefix, int32_t value, unsigned char decimals);
+
+/** 
+ * This function shows a signed integer, see pt6961_show_fixed.
+ * 
+ * @param pt pointer to PT6961 configuration structure
+ * @param prefix text shown on the left, may be 0
+ * @param value number to show
+ */
+void pt6961_show_s32(PT6961_Init* pt, const char* prefix, int32_t value);
+
+/** 
+ * This function shows an unsigned integer, see pt6961_show_fixed.
+ * 
+ * @param pt pointer to PT6961 configuration structure
+ * @param prefix text shown on the left, may be 0
+ * @param value number to show
+ */
+void pt6961_show_u32(PT6961_Init* pt, const char* prefix, uint32_t value);
+
 /** 
  * This function returns key pressed on interface board. If there is a
  * callback given in configuration, it is called.
@@ -103,6 +265,72 @@ void pt6961_print(PT6961_Init* pt, const char* data);
  */
 void pt6961_set(PT6961_Init* pt, const char* data);
 
+/** 
+ * This function makes given digits blink. Whole display blinks with
+ * display control command, single digits are masked in the
+ * framebuffer. Either way, only transitions are sent to the chip.
+ * 
+ * @param pt pointer to PT6961 configuration structure
+ * @param mask digits to blink, bit 0 is the leftmost, zero stops blinking
+ * @param period_ms full blink period
+ */
+void pt6961_blink(PT6961_Init* pt, unsigned char mask, uint16_t period_ms);
+
+/** 
+ * This function ramps display brightness to given level, one level
+ * per step. Each step is a single display control command.
+ * 
+ * @param pt pointer to PT6961 configuration structure
+ * @param level target brightness, 0 - PT_BRIGHTNESS_MAX
+ * @param step_ms time of one step, zero changes at once
+ */
+void pt6961_fade(PT6961_Init* pt, unsigned char level, uint16_t step_ms);
+
+/** 
+ * This function runs display effects, scheduled from the SysTick
+ * counter. Must be called from the main loop, so it does not
+ * interleave with other transfers on the bus.
+ * 
+ * @param pt pointer to PT6961 configuration structure
+ */
+void pt6961_effects(PT6961_Init* pt);
+
+/** 
+ * This function joins chips into a shared bus. Must be called before
+ * pt6961_start (or pt6961_init) of these chips.
+ * 
+ * @param bus pointer to bus structure
+ * @param chips table of chips sharing CLK, DIN and DOUT
+ * @param count number of chips
+ */
+void pt6961_bus_init(PT6961_Bus* bus, PT6961_Init** chips, unsigned char count);
+
+/** 
+ * This function sends framebuffers of all chips changed since the
+ * last flush, in one pass. Call it from the main loop.
+ * 
+ * @param bus pointer to bus structure
+ */
+void pt6961_bus_flush(PT6961_Bus* bus);
+
+/** 
+ * This function scans keys of the chips, one chip every PT_SCAN_MS,
+ * round-robin. Call it every millisecond from the SysTick interrupt.
+ * 
+ * @param bus pointer to bus structure
+ */
+void pt6961_bus_tick(PT6961_Bus* bus);
+
+/** 
+ * This function returns key found by the scan and clears it.
+ * 
+ * @param bus pointer to bus structure
+ * @param chip place for index of the chip the key came from, may be 0
+ * 
+ * @return key code, zero if no key
+ */
+unsigned char pt6961_bus_key(PT6961_Bus* bus, unsigned char* chip);
+
 /** 
  * This function turns the display on.
  * 
@@ -117,4 +345,12 @@ void pt6961_on(PT6961_Init* pt);
  */
 void pt6961_off(PT6961_Init* pt);
 
+/** 
+ * This function sets display brightness at once, stopping any fade.
+ * 
+ * @param pt pointer to PT6961 configuration structure
+ * @param level brightness, 0 - PT_BRIGHTNESS_MAX
+ */
+void pt6961_set_brightness(PT6961_Init* pt, unsigned char level);
+
 #endif /* PT6961_H */
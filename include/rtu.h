@@ -0,0 +1,36 @@
+#ifndef RTU_H
+#define RTU_H
+/**
+ * @file   rtu.h
+ * @author Wiktor Gołgowski <wgolgowski@gmail.com>
+ * @date   Wed Oct 21 15:40:27 2026
+ * 
+ * @brief  Modbus RTU framing on the serial port. A frame ends after
+ * 3.5 characters of silence: the USART reports an idle line after one
+ * character and TIM14 times the rest.
+ * 
+ */
+
+
+#include "stm32f0xx.h"
+
+/** 
+ * This function switches the serial port to 8E1 and starts frame end
+ * detection. Call after serial_init.
+ * 
+ * @param baud bit rate, as given to serial_init
+ */
+void rtu_init(uint32_t baud);
+
+/** 
+ * This function copies a complete frame out of the receive ring.
+ * 
+ * @param dst output
+ * @param max size of output
+ * 
+ * @return number of frame bytes, 0 if none is complete; of a frame
+ * longer than max only max bytes are copied, the rest is skipped
+ */
+uint16_t rtu_frame(unsigned char* dst, uint16_t max);
+
+#endif /* RTU_H */
@@ -0,0 +1,71 @@
+#ifndef SCHED_H
+#define SCHED_H
+/**
+ * @file   sched.h
+ * @author Wiktor Gołgowski <wgolgowski@gmail.com>
+ * @date   Mon Oct 19 21:04:52 2026
+ *
+ * @brief  Cooperative scheduler of periodic tasks, driven by the
+ * millisecond tick.
+ *
+ */
+
+
+#include "stm32f0xx.h"
+#include "delay.h"
+
+/**
+ * Periodic task with its run-time statistics. Tasks are kept in a
+ * table ordered by priority, the first due task runs first. A task
+ * overruns when it ends later than its deadline after release.
+ */
+typedef struct strSchedTask
+{
+    void (*run)(void);
+    uint16_t period_ms;
+    uint16_t deadline_us;  /* from release to end of run */
+    deadline_t release;    /* tick of next release */
+    __IO unsigned char wake; /* released now, set by sched_wake */
+    uint32_t runs;
+    uint32_t overruns;
+    uint32_t worst_cycles; /* longest single run */
+    uint32_t busy_cycles;  /* sum of run times, wraps around */
+} SchedTask;
+
+/// Task table entry, statistics start from zero.
+#define SCHED_TASK(run, period_ms, deadline_us) {run, period_ms, deadline_us, 0, 0, 0, 0, 0, 0}
+
+/**
+ * This function sets the task table and releases all tasks at once.
+ *
+ * @param tasks table of tasks, first has the highest priority
+ * @param count number of tasks
+ */
+void sched_init(SchedTask* tasks, unsigned char count);
+
+/**
+ * This function runs the highest priority task that is due, if any.
+ * A task that missed whole periods is not run again to catch up, its
+ * next release is moved past the current tick.
+ *
+ * @return 1 if a task was run, 0 if nothing is due
+ */
+unsigned char sched_poll(void);
+
+/**
+ * This function releases a task now, regardless of its period. It is
+ * safe to call from interrupts, e.g. to react to a wake-up source.
+ *
+ * @param task task to release
+ */
+void sched_wake(SchedTask* task);
+
+/**
+ * This function returns the tick of the earliest task release, which
+ * may be in the past. Idle code sleeps until then.
+ *
+ * @return earliest release
+ */
+deadline_t sched_next_release(void);
+
+#endif /* SCHED_H */
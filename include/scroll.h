@@ -0,0 +1,73 @@
+#ifndef SCROLL_H
+#define SCROLL_H
+/**
+ * @file   scroll.h
+ * @author Wiktor Gołgowski <wgolgowski@gmail.com>
+ * @date   Mon Oct 19 18:05:44 2026
+ * 
+ * @brief  Scrolling viewport showing long messages on the six-digit
+ * display. Messages are queued with priorities, the highest one owns
+ * the display.
+ * 
+ */
+
+
+#include "pt6961.h"
+
+/// Longest message, in display positions.
+#define SCROLL_MSG_LEN 32
+
+/// Number of messages which may wait in the queue.
+#define SCROLL_SLOTS 4
+
+/// Default time of one scroll step.
+#define SCROLL_STEP_MS 300
+
+/// Returned when the message could not be queued.
+#define SCROLL_NONE 0xFF
+
+/// Message priorities, higher value wins.
+enum
+{
+    SCROLL_STATUS = 1,
+    SCROLL_FAULT = 2
+};
+
+/** 
+ * This function queues a message. The text is converted to segment
+ * bytes here, so scrolling itself only moves a pointer. If the queue
+ * is full, the oldest message of lower priority is dropped.
+ * 
+ * @param priority SCROLL_STATUS, SCROLL_FAULT
+ * @param text message, longer text is cut to SCROLL_MSG_LEN
+ * @param repeat number of passes, zero scrolls until cancelled
+ * 
+ * @return message id for scroll_cancel, SCROLL_NONE if not queued
+ */
+unsigned char scroll_post(unsigned char priority, const char* text, unsigned char repeat);
+
+/** 
+ * This function removes a message from the queue.
+ * 
+ * @param id message id returned by scroll_post
+ */
+void scroll_cancel(unsigned char id);
+
+/** 
+ * This function sets scroll rate.
+ * 
+ * @param rate time of one scroll step, ms
+ */
+void scroll_set_rate(uint16_t rate);
+
+/** 
+ * This function moves the message shown, when its step time has
+ * come. Call it from the main loop.
+ * 
+ * @param pt pointer to PT6961 configuration structure
+ * 
+ * @return 1 if a message owns the display, 0 otherwise
+ */
+unsigned char scroll_poll(PT6961_Init* pt);
+
+#endif /* SCROLL_H */
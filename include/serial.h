@@ -0,0 +1,91 @@
+#ifndef SERIAL_H
+#define SERIAL_H
+/**
+ * @file   serial.h
+ * @author Wiktor Gołgowski <wgolgowski@gmail.com>
+ * @date   Tue Oct 20 16:31:08 2026
+ * 
+ * @brief  Serial port on USART2 (TX on PA2, RX on PA3), transmitted
+ * by DMA and received by DMA into a circular buffer. USART1 pins are
+ * taken by the power stage and the display.
+ *
+ * The line is RS-485, shared by several drives. PA4 drives the
+ * transceiver DE (and /RE) high only while sending, from the start of
+ * a transfer until the last stop bit has left the shift register.
+ * Drives only transmit replies to requests, never on their own.
+ * 
+ */
+
+
+#include "stm32f0xx.h"
+
+/// Default bit rate, 8N1.
+#define SERIAL_BAUD 115200
+
+/// Receive ring size. It must be read before it wraps, 11 ms at 115200.
+#define SERIAL_RX_SIZE 128
+
+/// Pin of GPIOA driving the RS-485 driver enable. PA1 (hardware DE)
+/// is the ambient light input.
+#define SERIAL_DE_PIN 4
+
+/** 
+ * This function configures the pins, USART2 and its DMA channel.
+ * 
+ * @param baud bit rate
+ */
+void serial_init(uint32_t baud);
+
+/** 
+ * This function sets a function called from the USART interrupt when
+ * the receive line goes idle, e.g. to find ends of frames, and enables
+ * the idle line interrupt.
+ * 
+ * @param handler function to call, 0 for none
+ */
+void serial_on_idle(void (*handler)(void));
+
+/** 
+ * This function checks if serial_send would accept a buffer now.
+ * 
+ * @return 1 if a buffer can be sent or queued
+ */
+unsigned char serial_ready(void);
+
+/** 
+ * This function starts sending a buffer by DMA, or queues it behind the
+ * one being sent (one deep). The buffer must not change until sent.
+ * 
+ * @param data bytes to send
+ * @param len number of bytes
+ * 
+ * @return 1 if started or queued, 0 if the queue is full
+ */
+unsigned char serial_send(const unsigned char* data, uint16_t len);
+
+/** 
+ * This function returns received bytes without copying them. The bytes
+ * stay in the ring until skipped. Since the ring wraps, call again
+ * after serial_skip to get the rest.
+ * 
+ * @param data set to the first unread byte
+ * 
+ * @return number of contiguous unread bytes
+ */
+uint16_t serial_peek(const unsigned char** data);
+
+/** 
+ * This function counts unread bytes, including the wrapped part.
+ * 
+ * @return number of unread bytes
+ */
+uint16_t serial_unread(void);
+
+/** 
+ * This function releases bytes returned by serial_peek.
+ * 
+ * @param len number of bytes used
+ */
+void serial_skip(uint16_t len);
+
+#endif /* SERIAL_H */
@@ -0,0 +1,48 @@
+#ifndef TELEMETRY_H
+#define TELEMETRY_H
+/**
+ * @file   telemetry.h
+ * @author Wiktor Gołgowski <wgolgowski@gmail.com>
+ * @date   Tue Oct 20 16:31:08 2026
+ * 
+ * @brief  Telemetry record, an engine snapshot returned by
+ * COMMAND_STATS. The drives share the line, so it is only sent when
+ * asked. The packed layout is shared with the host decoder in tools/.
+ * 
+ */
+
+
+#include <stdint.h>
+
+/// Packed record length, without CRC.
+#define TELEMETRY_RECORD_LEN 22
+
+/// Bits of flags.
+#define TELEMETRY_FAULT 0x01
+#define TELEMETRY_STARTED 0x02
+#define TELEMETRY_DIRECTION 0x04
+
+/// Engine snapshot, fields in packing order.
+typedef struct strTelemetry
+{
+    uint32_t time_ms;
+    unsigned char state;
+    unsigned char phase;
+    unsigned char flags;
+    unsigned char idle_percent;
+    uint16_t requested_rpm;
+    uint16_t rpm;
+    uint16_t current[3];    /* 0.1 A */
+    uint16_t jitter_us;     /* worst commutation jitter */
+    uint16_t overruns;      /* scheduler overruns, all tasks */
+} Telemetry;
+
+/** 
+ * This function packs a record little-endian, as sent in replies.
+ * 
+ * @param out output, TELEMETRY_RECORD_LEN bytes
+ * @param t record to pack
+ */
+void telemetry_pack(unsigned char* out, const Telemetry* t);
+
+#endif /* TELEMETRY_H */
@@ -0,0 +1,60 @@
+#ifndef WATCHDOG_H
+#define WATCHDOG_H
+/**
+ * @file   watchdog.h
+ * @author Wiktor Gołgowski <wgolgowski@gmail.com>
+ * @date   Tue Oct 20 14:05:51 2026
+ * 
+ * @brief  Independent watchdog, fed only while every supervised
+ * client checks in within its deadline.
+ * 
+ */
+
+
+#include "stm32f0xx.h"
+
+/// Watchdog timeout, longer than a flash page erase.
+#define WATCHDOG_TIMEOUT_MS 250
+
+/// Supervised clients, deadlines are in watchdog.c.
+enum
+{
+    WDG_TICK,    /* SysTick handler, commutation heartbeat */
+    WDG_ENGINE,  /* engine state machine task */
+    WDG_KEYS,    /* key handling task */
+    WDG_CLIENTS
+};
+
+/** 
+ * This function returns reset flags of the last reset and clears them.
+ * Call it once, at boot.
+ * 
+ * @return RCC_CSR flags shifted right by 24 (PINRSTF is bit 2, PORRSTF
+ * bit 3, SFTRSTF bit 4, IWDGRSTF bit 5...)
+ */
+unsigned char watchdog_reset_flags(void);
+
+/** 
+ * This function starts the IWDG and TIM16, which times the check-ins
+ * independently of the SysTick tick. The IWDG cannot be stopped
+ * afterwards. All clients count as checked in at start.
+ * 
+ */
+void watchdog_init(void);
+
+/** 
+ * This function records that a client is alive. It is safe to call
+ * from interrupts.
+ * 
+ * @param client WDG_* client
+ */
+void watchdog_checkin(unsigned char client);
+
+/** 
+ * This function feeds the watchdog, if no client missed its deadline.
+ * Call it periodically, well within WATCHDOG_TIMEOUT_MS.
+ * 
+ */
+void watchdog_poll(void);
+
+#endif /* WATCHDOG_H */
@@ -0,0 +1,76 @@
+/**
+ * @file   ambient.c
+ * @author Wiktor Gołgowski <wgolgowski@gmail.com>
+ * @date   Mon Oct 19 17:20:05 2026
+ * 
+ * @brief  Ambient-adaptive display dimming implementation.
+ * 
+ */
+
+#include "stm32f0xx.h"
+#include "ambient.h"
+#include "delay.h"
+
+/* Filter strength, reading moves 1/2^AMBIENT_FILTER towards sample. */
+#define AMBIENT_FILTER 3
+
+static unsigned char enabled;
+static uint32_t filtered; /* 12-bit reading, scaled by 2^AMBIENT_FILTER */
+static uint32_t next_sample;
+
+void ambient_init(void)
+{
+    RCC->AHBENR |= RCC_AHBENR_GPIOAEN;
+    RCC->APB2ENR |= RCC_APB2ENR_ADC1EN;
+
+    GPIOA->MODER |= GPIO_MODER_MODER1; /* PA1 analog */
+
+    ADC1->CFGR2 = ADC_CFGR2_JITOFFDIV4; /* 12 MHz from PCLK */
+    ADC1->SMPR = ADC_SMPR1_SMPR; /* longest sampling, sensor is slow */
+    ADC1->CHSELR = ADC_CHSELR_CHSEL1;
+
+    ADC1->CR |= ADC_CR_ADCAL;
+    while(ADC1->CR & ADC_CR_ADCAL);
+    ADC1->CR |= ADC_CR_ADEN;
+    while(!(ADC1->ISR & ADC_ISR_ADRDY));
+
+    filtered = 0;
+    next_sample = tick_get();
+    ADC1->CR |= ADC_CR_ADSTART;
+}
+
+void ambient_enable(unsigned char on)
+{
+    enabled = on;
+}
+
+unsigned char ambient_enabled(void)
+{
+    return enabled;
+}
+
+void ambient_poll(PT6961_Init* pt)
+{
+    if(!enabled || (int32_t)(tick_get() - next_sample) < 0 || !(ADC1->ISR & ADC_ISR_EOC))
+    {
+        return;
+    }
+    next_sample += AMBIENT_PERIOD_MS;
+
+    uint32_t sample = ADC1->DR; /* clears EOC */
+    ADC1->CR |= ADC_CR_ADSTART;
+
+    /* Exponential moving average, no division. */
+    filtered = filtered - (filtered >> AMBIENT_FILTER) + sample;
+
+    /* Top three bits of the 12-bit reading give the level. Keep the
+     * current level unless the reading is clearly out of its range, so
+     * the display does not flicker on the boundary. */
+    uint32_t reading = filtered >> AMBIENT_FILTER;
+    uint32_t low = (uint32_t)pt->fade_target << 9;
+    uint32_t high = low + (1 << 9);
+    if(reading + 64 < low || reading >= high + 64)
+    {
+        pt6961_fade(pt, reading >> 9, AMBIENT_FADE_MS);
+    }
+}
@@ -0,0 +1,66 @@
+/**
+ * @file   cobs.c
+ * @author Wiktor Gołgowski <wgolgowski@gmail.com>
+ * @date   Tue Oct 20 16:31:08 2026
+ * 
+ * @brief  Consistent Overhead Byte Stuffing. Each block starts with a
+ * code byte: distance to the next zero (removed) or, for 0xFF, a run
+ * of 254 non-zero bytes with no zero after it.
+ * 
+ */
+
+#include "cobs.h"
+
+uint16_t cobs_encode(unsigned char* dst, const unsigned char* src, uint16_t len)
+{
+    uint16_t code_pos = 0;
+    uint16_t out = 1;
+    unsigned char code = 1;
+
+    while(len-- != 0)
+    {
+        unsigned char b = *src++;
+        if(b != 0)
+        {
+            dst[out++] = b;
+            code++;
+        }
+        if(b == 0 || (code == 0xFF && len != 0))
+        {
+            dst[code_pos] = code;
+            code_pos = out++;
+            code = 1;
+        }
+    }
+    dst[code_pos] = code;
+    return out;
+}
+
+uint16_t cobs_decode(unsigned char* dst, const unsigned char* src, uint16_t len)
+{
+    uint16_t in = 0;
+    uint16_t out = 0;
+
+    while(in < len)
+    {
+        unsigned char code = src[in++];
+        if(code == 0 || in + code - 1 > len)
+        {
+            return 0;
+        }
+        unsigned char i;
+        for(i = 1; i < code; i++)
+        {
+            if(src[in] == 0)
+            {
+                return 0;
+            }
+            dst[out++] = src[in++];
+        }
+        if(code != 0xFF && in < len)
+        {
+            dst[out++] = 0;
+        }
+    }
+    return out;
+}
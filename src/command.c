@@ -0,0 +1,132 @@
+/**
+ * @file   command.c
+ * @author Wiktor Gołgowski <wgolgowski@gmail.com>
+ * @date   Wed Oct 21 10:14:52 2026
+ * 
+ * @brief  Binary command protocol parser.
+ * 
+ */
+
+#include "command.h"
+#include "crc16.h"
+
+void command_init(CommandPort* port, const Command* commands, unsigned char count,
+                  unsigned char address,
+                  unsigned char (*ready)(void),
+                  unsigned char (*send)(const unsigned char* data, uint16_t len))
+{
+    port->commands = commands;
+    port->count = count;
+    port->address = address;
+    port->ready = ready;
+    port->send = send;
+    port->len = 0;
+    port->pending = 0;
+    port->fill = 0;
+    port->errors = 0;
+}
+
+/** 
+ * Helper function. Checks and executes a complete request, then sends
+ * the reply. The transmitter must be ready.
+ * 
+ * @param port pointer to parser state
+ */
+static void command_frame(CommandPort* port)
+{
+    unsigned char* f = port->frame;
+    uint16_t n = cobs_decode(f, f, port->len);
+
+    if(n < 4 || crc16(CRC16_INIT, f, n - 2) != (f[n-2] | (f[n-1] << 8)))
+    {
+        port->errors++;
+        return;
+    }
+    if(f[0] != port->address && f[0] != COMMAND_BROADCAST)
+    {
+        return; /* another drive */
+    }
+
+    unsigned char raw[COMMAND_FRAME_MAX];
+    int16_t result = -COMMAND_UNKNOWN;
+    unsigned char i;
+    for(i = 0; i < port->count; i++)
+    {
+        if(port->commands[i].code == f[1])
+        {
+            result = port->commands[i].run(f + 2, n - 4, raw + 3);
+            break;
+        }
+    }
+    if(f[0] == COMMAND_BROADCAST)
+    {
+        return;
+    }
+
+    uint16_t len = 3;
+    raw[0] = port->address;
+    raw[1] = f[1] | COMMAND_REPLY;
+    raw[2] = result < 0 ? -result : COMMAND_OK;
+    if(result > 0)
+    {
+        len += result;
+    }
+    uint16_t crc = crc16(CRC16_INIT, raw, len);
+    raw[len++] = crc;
+    raw[len++] = crc >> 8;
+
+    unsigned char* out = port->reply[port->fill];
+    len = cobs_encode(out, raw, len);
+    out[len++] = 0;
+    port->send(out, len);
+    port->fill ^= 1;
+}
+
+uint16_t command_feed(CommandPort* port, const unsigned char* data, uint16_t len)
+{
+    uint16_t used = 0;
+
+    if(port->pending)
+    {
+        if(!port->ready())
+        {
+            return 0;
+        }
+        command_frame(port);
+        port->pending = 0;
+        port->len = 0;
+    }
+
+    while(used < len)
+    {
+        unsigned char b = data[used++];
+        if(b != 0)
+        {
+            if(port->len < sizeof(port->frame))
+            {
+                port->frame[port->len] = b;
+            }
+            if(port->len <= sizeof(port->frame))
+            {
+                port->len++;
+            }
+            continue;
+        }
+
+        if(port->len > sizeof(port->frame))
+        {
+            port->errors++;
+        }
+        else if(port->len != 0)
+        {
+            if(!port->ready())
+            {
+                port->pending = 1;
+                return used;
+            }
+            command_frame(port);
+        }
+        port->len = 0;
+    }
+    return used;
+}
@@ -0,0 +1,29 @@
+/**
+ * @file   crc16.c
+ * @author Wiktor Gołgowski <wgolgowski@gmail.com>
+ * @date   Tue Oct 20 16:31:08 2026
+ * 
+ * @brief  CRC-16/CCITT, a nibble at a time. The 16-entry table costs
+ * 32 bytes of flash instead of 512.
+ * 
+ */
+
+#include "crc16.h"
+
+/// CRC of one nibble, indexed by (crc >> 12) ^ nibble.
+static const uint16_t crc_nibble[16] =
+{
+    0x0000, 0x1021, 0x2042, 0x3063, 0x4084, 0x50A5, 0x60C6, 0x70E7,
+    0x8108, 0x9129, 0xA14A, 0xB16B, 0xC18C, 0xD1AD, 0xE1CE, 0xF1EF
+};
+
+uint16_t crc16(uint16_t crc, const unsigned char* data, uint16_t len)
+{
+    while(len-- != 0)
+    {
+        unsigned char b = *data++;
+        crc = (crc << 4) ^ crc_nibble[(crc >> 12) ^ (b >> 4)];
+        crc = (crc << 4) ^ crc_nibble[(crc >> 12) ^ (b & 0x0F)];
+    }
+    return crc;
+}
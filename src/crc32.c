@@ -0,0 +1,148 @@
+/**
+ * @file   crc32.c
+ * @author Wiktor Gołgowski <wgolgowski@gmail.com>
+ * @date   Thu Oct 22 11:05:39 2026
+ * 
+ * @brief  CRC-32 on the CRC unit, or in software for the host.
+ * 
+ */
+
+#include "crc32.h"
+
+#ifdef CRC32_SOFTWARE
+
+/// Reflected CRC of one nibble, like crc16.c.
+static const uint32_t crc_nibble[16] =
+{
+    0x00000000, 0x1DB71064, 0x3B6E20C8, 0x26D930AC,
+    0x76DC4190, 0x6B6B51F4, 0x4DB26158, 0x5005713C,
+    0xEDB88320, 0xF00F9344, 0xD6D6A3E8, 0xCB61B38C,
+    0x9B64C2B0, 0x86D3D2D4, 0xA00AE278, 0xBDBDF21C
+};
+
+static uint32_t crc;
+
+void crc32_start(void)
+{
+    crc = 0xFFFFFFFF;
+}
+
+void crc32_update(const void* data, uint32_t len)
+{
+    const unsigned char* p = data;
+    while(len-- != 0)
+    {
+        unsigned char b = *p++;
+        crc = (crc >> 4) ^ crc_nibble[(crc ^ b) & 0x0F];
+        crc = (crc >> 4) ^ crc_nibble[(crc ^ (b >> 4)) & 0x0F];
+    }
+}
+
+uint32_t crc32_result(void)
+{
+    return ~crc;
+}
+
+#else
+
+#include "stm32f0xx.h"
+
+/* Largest DMA transfer, in words. */
+#define DMA_WORDS_MAX 0xFFFF
+
+void crc32_start(void)
+{
+    RCC->AHBENR |= RCC_AHBENR_CRCEN;
+    CRC->INIT = 0xFFFFFFFF;
+    /* Words are bit-reversed whole, so the first byte goes first. */
+    CRC->CR = CRC_CR_REV_IN | CRC_CR_REV_OUT | CRC_CR_RESET;
+}
+
+/** 
+ * Helper function. Feeds single bytes, reversed each.
+ * 
+ * @param p bytes
+ * @param len number of bytes
+ */
+static void crc32_bytes(const unsigned char* p, uint32_t len)
+{
+    CRC->CR = (CRC->CR & ~CRC_CR_REV_IN) | CRC_CR_REV_IN_0;
+    while(len-- != 0)
+    {
+        *(__IO uint8_t*)&CRC->DR = *p++;
+    }
+    CRC->CR |= CRC_CR_REV_IN;
+}
+
+/** 
+ * Helper function. Feeds words by memory to memory DMA (channel 3)
+ * and waits for the end. The bus is shared, so this is not faster by
+ * much, but no CPU time goes to the copy loop.
+ * 
+ * @param w aligned words
+ * @param words number of words
+ */
+static void crc32_dma(const uint32_t* w, uint32_t words)
+{
+    RCC->AHBENR |= RCC_AHBENR_DMA1EN;
+    DMA1_Channel3->CPAR = (uint32_t)&CRC->DR;
+    while(words != 0)
+    {
+        uint32_t n = words < DMA_WORDS_MAX ? words : DMA_WORDS_MAX;
+        DMA1_Channel3->CMAR = (uint32_t)w;
+        DMA1_Channel3->CNDTR = n;
+        DMA1_Channel3->CCR = DMA_CCR_MEM2MEM | DMA_CCR_DIR | DMA_CCR_MINC
+            | DMA_CCR_PSIZE_1 | DMA_CCR_MSIZE_1 | DMA_CCR_EN;
+        while(!(DMA1->ISR & DMA_ISR_TCIF3))
+            ;
+        DMA1->IFCR = DMA_IFCR_CTCIF3;
+        DMA1_Channel3->CCR = 0;
+        w += n;
+        words -= n;
+    }
+}
+
+void crc32_update(const void* data, uint32_t len)
+{
+    const unsigned char* p = data;
+
+    uint32_t head = (4 - ((uint32_t)p & 3)) & 3;
+    if(head > len)
+    {
+        head = len;
+    }
+    crc32_bytes(p, head);
+    p += head;
+    len -= head;
+
+    const uint32_t* w = (const uint32_t*)p;
+    uint32_t words = len >> 2;
+    if(len >= CRC32_DMA_MIN)
+    {
+        crc32_dma(w, words);
+    }
+    else
+    {
+        uint32_t i;
+        for(i = 0; i < words; i++)
+        {
+            CRC->DR = w[i];
+        }
+    }
+
+    crc32_bytes(p + 4 * words, len & 3);
+}
+
+uint32_t crc32_result(void)
+{
+    return ~CRC->DR;
+}
+
+#endif /* CRC32_SOFTWARE */
+
+uint32_t crc32(const void* data, uint32_t len)
+{
+    crc32_start();
+    crc32_update(data, len);
+    return crc32_result();
+}
@@ -0,0 +1,159 @@
+/**
+ * @file   delay.c
+ * @author Wiktor Gołgowski <wgolgowski@gmail.com>
+ * @date   Mon Oct 19 20:11:05 2026
+ *
+ * @brief  Millisecond tick, calibrated busy waits and deadlines. Sub
+ * millisecond waits use the SysTick down-counter, which runs from the
+ * core clock.
+ *
+ */
+
+#include "delay.h"
+
+static __IO uint32_t tick_counter; /* milliseconds since start */
+static __IO uint32_t tick_step = 1; /* ms counted by next SysTick interrupt */
+
+uint32_t tick_increment(void)
+{
+    uint32_t step = tick_step;
+    tick_counter += step;
+    tick_step = 1;
+    return step;
+}
+
+/** 
+ * Helper function. Starts a SysTick period of given length, following
+ * periods are one tick long again. Interrupts must be disabled.
+ * 
+ * @param cycles length of the period, at least 2
+ * @param period length of one tick in cycles
+ */
+static void tick_reload(uint32_t cycles, uint32_t period)
+{
+    SysTick->LOAD = cycles - 1;
+    SysTick->VAL = 0; /* reload on the next clock */
+    while(SysTick->VAL == 0);
+    SysTick->LOAD = period - 1; /* taken at the next reload */
+}
+
+uint32_t tick_sleep(uint32_t ms)
+{
+    uint32_t period = SysTick->LOAD + 1;
+    uint32_t max = (SysTick_LOAD_RELOAD_Msk + 1) / period;
+    if(ms > max)
+    {
+        ms = max;
+    }
+
+    if(ms < 2 || (SCB->ICSR & SCB_ICSR_PENDSTSET_Msk))
+    {
+        /* Next tick is soon enough, or already here. */
+        uint32_t start = cycle_get();
+        __WFI();
+        __enable_irq();
+        return cycle_get() - start;
+    }
+
+    /* Stretch the current tick to the end of the sleep. */
+    uint32_t left = SysTick->VAL;
+    uint32_t cycles = left + (ms - 1) * period;
+    tick_reload(cycles, period);
+    tick_step = ms;
+
+    __WFI(); /* wakes on pending interrupts, even though masked */
+
+    uint32_t slept = cycles;
+    uint32_t val = SysTick->VAL; /* read before the pending check */
+    if(!(SCB->ICSR & SCB_ICSR_PENDSTSET_Msk))
+    {
+        /* Woken up earlier, count the ticks passed so far and
+         * resynchronise to the tick boundary. */
+        slept = cycles - val;
+        uint32_t passed = 0;
+        uint32_t rest = left - slept;
+        if(slept >= left)
+        {
+            passed = 1 + (slept - left) / period;
+            rest = period - (slept - left) % period;
+        }
+        if(rest < 2)
+        {
+            rest = 2;
+        }
+        tick_reload(rest, period);
+        tick_step = 1;
+        if(passed != 0)
+        {
+            /* Handler runs now and catches up, the next one counts
+             * the rest of the current tick. */
+            tick_step = passed;
+            SCB->ICSR = SCB_ICSR_PENDSTSET_Msk;
+        }
+    }
+    __enable_irq();
+    return slept;
+}
+
+uint32_t tick_get(void)
+{
+    return tick_counter;
+}
+
+uint32_t cycle_get(void)
+{
+    uint32_t reload = SysTick->LOAD;
+    uint32_t ms, val;
+    do
+    {
+        ms = tick_counter;
+        val = SysTick->VAL;
+    } while(ms != tick_counter);
+    return ms * (reload + 1) + (reload - val);
+}
+
+deadline_t deadline_in(uint32_t ms)
+{
+    return tick_counter + ms;
+}
+
+unsigned char deadline_expired(deadline_t deadline)
+{
+    return (int32_t)(tick_counter - deadline) >= 0;
+}
+
+void DelayMs(__IO uint32_t ms)
+{
+    /* One more tick, as the current one is already partly gone. */
+    deadline_t deadline = deadline_in(ms + 1);
+    while(!deadline_expired(deadline))
+    {
+        __WFI(); /* woken up by SysTick at least */
+    }
+}
+
+void delay_cycles(uint32_t cycles)
+{
+    uint32_t reload = SysTick->LOAD + 1;
+    uint32_t last = SysTick->VAL;
+
+    /* Counter runs down, elapsed cycles are summed over reloads. The
+     * loop is shorter than one reload, so no reload is missed unless an
+     * interrupt takes longer, which only extends the wait. */
+    while(cycles != 0)
+    {
+        uint32_t now = SysTick->VAL;
+        uint32_t elapsed = last >= now ? last - now : last + reload - now;
+        if(elapsed >= cycles)
+        {
+            break;
+        }
+        cycles -= elapsed;
+        last = now;
+    }
+}
+
+void delay_us(uint32_t us)
+{
+    delay_cycles(us * (SystemCoreClock / 1000000));
+}
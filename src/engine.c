@@ -0,0 +1,132 @@
+/**
+ * @file   engine.c
+ * @author Wiktor Gołgowski <wgolgowski@gmail.com>
+ * @date   Thu Oct 22 15:22:10 2026
+ * 
+ * @brief  Six-step commutation of instanced drives.
+ * 
+ */
+
+#include "engine.h"
+
+/// Configuration for the transistors (last two bits do not matter)
+static const unsigned char phase_configuration[ENGINE_PHASES] =
+{
+    0b00100001, 0b00000011, 0b00000110, 0b00001100, 0b00011000, 0b00110000
+};
+
+void engine_pins_safe(const EnginePins* pins)
+{
+    unsigned char i;
+    for(i = 0; i < ENGINE_PHASES; i++)
+    {
+        GPIO_TypeDef* port = pins->out[i].port;
+        uint32_t pin = pins->out[i].pin;
+        /* Port clocks are consecutive bits, ports are 1K apart. */
+        RCC->AHBENR |= RCC_AHBENR_GPIOAEN << (((uint32_t)port - GPIOA_BASE) >> 10);
+        port->BRR = 1 << pin;
+        port->MODER = (port->MODER & ~(3 << (pin * 2))) | (1 << (pin * 2));
+    }
+}
+
+void engine_init(Engine* engine, const EnginePins* pins)
+{
+    unsigned char i, p, k;
+
+    engine->phase_counter = 0;
+    engine->duration = 0;
+    engine->phase = 0;
+    engine->direction = 0;
+    engine->requested_direction = 0;
+    engine->started = 0;
+    engine->fault_overcurrent = 0;
+    engine->pattern = ENGINE_PHASES;
+    engine->state = ENGINE_INIT;
+    engine->ramp_counter = 0;
+    engine->rotation = 0;
+    engine->requested_rotation = 0;
+    CORO_INIT(&engine->reverse);
+    engine->pins = pins;
+
+    engine_pins_safe(pins);
+
+    GPIO_TypeDef* port = pins->fault.port;
+    port->MODER &= ~(3 << (pins->fault.pin * 2));
+    port->PUPDR = (port->PUPDR & ~(3 << (pins->fault.pin * 2))) | (1 << (pins->fault.pin * 2));
+
+    /* Ports of the outputs, in order of first use. */
+    for(k = 0; k < ENGINE_PORTS; k++)
+    {
+        engine->port_bsrr[k] = 0;
+    }
+    for(i = 0; i < ENGINE_PHASES; i++)
+    {
+        for(k = 0; k < ENGINE_PORTS - 1; k++)
+        {
+            if(engine->port_bsrr[k] == 0 || engine->port_bsrr[k] == &pins->out[i].port->BSRR)
+                break;
+        }
+        engine->port_bsrr[k] = &pins->out[i].port->BSRR;
+    }
+
+    /* BSRR sets with the low half, resets with the high one. */
+    for(p = 0; p <= ENGINE_PHASES; p++)
+    {
+        unsigned char cfg = p < ENGINE_PHASES ? phase_configuration[p] : 0;
+        for(k = 0; k < ENGINE_PORTS; k++)
+        {
+            engine->bsrr[p][k] = 0;
+        }
+        for(i = 0; i < ENGINE_PHASES; i++)
+        {
+            for(k = 0; engine->port_bsrr[k] != &pins->out[i].port->BSRR; k++)
+                ;
+            if(cfg & (1 << i))
+                engine->bsrr[p][k] |= 1 << pins->out[i].pin;
+            else
+                engine->bsrr[p][k] |= 1 << (pins->out[i].pin + 16);
+        }
+    }
+}
+
+void engine_tick(Engine* drives, unsigned char count)
+{
+    Engine* e;
+    for(e = drives; e != drives + count; e++)
+    {
+        if(e->phase_counter != 0)
+        {
+            e->phase_counter--;
+            continue;
+        }
+
+        if(e->direction == 1) //right
+        {
+            e->phase = e->phase < ENGINE_PHASES-1 ? e->phase + 1 : 0;
+        }
+        else
+        {
+            e->phase = e->phase != 0 ? e->phase - 1 : ENGINE_PHASES-1;
+        }
+        e->phase_counter = e->duration;
+    }
+}
+
+unsigned char engine_output(Engine* engine)
+{
+    unsigned char p = engine->rotation == 0 ? ENGINE_PHASES : engine->phase;
+    unsigned char changed = p != engine->pattern;
+    unsigned char k;
+
+    engine->pattern = p;
+    for(k = 0; k < ENGINE_PORTS && engine->port_bsrr[k] != 0; k++)
+    {
+        *engine->port_bsrr[k] = engine->bsrr[p][k];
+    }
+    return changed;
+}
+
+unsigned char engine_fault(const Engine* engine)
+{
+    return gpio_get(engine->pins->fault.port, engine->pins->fault.pin);
+}
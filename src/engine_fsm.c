@@ -0,0 +1,195 @@
+/**
+ * @file   engine_fsm.c
+ * @author Wiktor Gołgowski <wgolgowski@gmail.com>
+ * @date   Fri Oct 23 10:37:15 2026
+ *
+ * @brief  Drive control state machine, a const table of transitions
+ * by state and event.
+ *
+ */
+
+#include "engine_fsm.h"
+
+unsigned char engine_event(const Engine* engine)
+{
+    if(engine->requested_direction != engine->direction)
+        return ENGINE_EV_REVERSE;
+    if(engine->started && !engine->fault_overcurrent)
+        return ENGINE_EV_RUN;
+    return ENGINE_EV_STOP;
+}
+
+/** 
+ * Helper function. Sets the phase time of the current rotation. A
+ * shorter time applies to the phase in progress too.
+ * 
+ * @param e pointer to drive state
+ */
+static void engine_speed(Engine* e)
+{
+    if(e->rotation == 0)
+    {
+        return; /* outputs are off */
+    }
+    e->duration = 60000 / (e->rotation * ENGINE_PHASES);
+    if(e->phase_counter > e->duration)
+    {
+        e->phase_counter = e->duration;
+    }
+}
+
+/* State machine actions. */
+
+static void engine_reset(Engine* e)
+{
+    e->phase = 0;
+    e->rotation = 0;
+    e->direction = e->requested_direction;
+    e->started = 0;
+    e->fault_overcurrent = 0;
+}
+
+static void engine_ramp(Engine* e)
+{
+    if(e->rotation == e->requested_rotation)
+        return;
+    if(++e->ramp_counter < ENGINE_RAMP_STEPS)
+        return;
+    e->ramp_counter = 0;
+
+    if(e->rotation < e->requested_rotation)
+        e->rotation++;
+    else
+        e->rotation--;
+    engine_speed(e);
+}
+
+static void engine_coast(Engine* e)
+{
+    e->rotation = 0;
+}
+
+static void engine_halt(Engine* e)
+{
+    e->started = 0;
+    e->requested_rotation = 0;
+    e->rotation = 0;
+    CORO_INIT(&e->reverse);
+}
+
+/** 
+ * Helper function. Reverses the engine: brakes to zero, flips
+ * direction and restores the requested rotation.
+ * 
+ * @param e pointer to drive state
+ * 
+ * @return CORO_DONE when the direction is flipped
+ */
+static unsigned char engine_reverse(Engine* e)
+{
+    CORO_BEGIN(&e->reverse);
+    e->rotation_before_reverse = e->requested_rotation;
+    while(e->rotation > 0)
+    {
+        e->requested_rotation = 0;
+        CORO_YIELD(&e->reverse);
+    }
+
+    e->direction = e->requested_direction;
+    e->requested_rotation = e->rotation_before_reverse;
+    e->phase = 0;
+    e->started = 1;
+    CORO_END(&e->reverse);
+}
+
+static void engine_reverse_step(Engine* e)
+{
+    if(engine_reverse(e) == CORO_WAITING)
+    {
+        engine_ramp(e); /* brake */
+    }
+}
+
+/** 
+ * Helper function. Gives up a reversal in progress, when the direction
+ * was requested back, and restores the requested rotation.
+ * 
+ * @param e pointer to drive state
+ */
+static void engine_cancel_reverse(Engine* e)
+{
+    if(e->reverse.line != 0)
+    {
+        e->requested_rotation = e->rotation_before_reverse;
+        CORO_INIT(&e->reverse);
+    }
+}
+
+static void engine_resume(Engine* e)
+{
+    engine_cancel_reverse(e);
+    engine_ramp(e);
+}
+
+static void engine_resume_stopped(Engine* e)
+{
+    engine_cancel_reverse(e);
+    engine_coast(e);
+}
+
+/// One transition: action (may be 0), then the next state.
+typedef struct strEngineTransition
+{
+    void (*action)(Engine* e);
+    unsigned char next;
+} EngineTransition;
+
+/// Transitions by state and event.
+static const EngineTransition engine_fsm[ENGINE_STATES][ENGINE_EVENTS] =
+{
+    [ENGINE_INIT] =
+    {
+        [ENGINE_EV_RUN]     = {engine_reset,          ENGINE_READY},
+        [ENGINE_EV_STOP]    = {engine_reset,          ENGINE_READY},
+        [ENGINE_EV_REVERSE] = {engine_reset,          ENGINE_READY},
+        [ENGINE_EV_FAULT]   = {engine_halt,           ENGINE_STOPPED}
+    },
+    [ENGINE_READY] =
+    {
+        [ENGINE_EV_RUN]     = {engine_ramp,           ENGINE_RUNNING},
+        [ENGINE_EV_STOP]    = {engine_coast,          ENGINE_READY},
+        [ENGINE_EV_REVERSE] = {engine_reverse_step,   ENGINE_REVERSING},
+        [ENGINE_EV_FAULT]   = {engine_halt,           ENGINE_STOPPED}
+    },
+    [ENGINE_RUNNING] =
+    {
+        [ENGINE_EV_RUN]     = {engine_ramp,           ENGINE_RUNNING},
+        [ENGINE_EV_STOP]    = {engine_coast,          ENGINE_READY},
+        [ENGINE_EV_REVERSE] = {engine_reverse_step,   ENGINE_REVERSING},
+        [ENGINE_EV_FAULT]   = {engine_halt,           ENGINE_STOPPED}
+    },
+    [ENGINE_STOPPED] =
+    {
+        [ENGINE_EV_RUN]     = {0,                     ENGINE_READY},
+        [ENGINE_EV_STOP]    = {0,                     ENGINE_READY},
+        [ENGINE_EV_REVERSE] = {0,                     ENGINE_READY},
+        [ENGINE_EV_FAULT]   = {engine_halt,           ENGINE_STOPPED}
+    },
+    [ENGINE_REVERSING] =
+    {
+        [ENGINE_EV_RUN]     = {engine_resume,         ENGINE_RUNNING},
+        [ENGINE_EV_STOP]    = {engine_resume_stopped, ENGINE_READY},
+        [ENGINE_EV_REVERSE] = {engine_reverse_step,   ENGINE_REVERSING},
+        [ENGINE_EV_FAULT]   = {engine_halt,           ENGINE_STOPPED}
+    }
+};
+
+void engine_handle(Engine* engine, unsigned char event)
+{
+    const EngineTransition* t = &engine_fsm[engine->state][event];
+    if(t->action != 0)
+    {
+        t->action(engine);
+    }
+    engine->state = t->next;
+}
@@ -0,0 +1,307 @@
+/**
+ * @file   events.c
+ * @author Wiktor Gołgowski <wgolgowski@gmail.com>
+ * @date   Tue Oct 20 11:40:26 2026
+ * 
+ * @brief  Event log. New events go to a RAM ring that is not cleared
+ * at startup, and are flushed in batches to one of two flash pages.
+ * When the current page is full the older one is erased and reused,
+ * so the log keeps the last 127 to 254 events.
+ * 
+ */
+
+#include "events.h"
+#include "flash.h"
+#include "delay.h"
+
+/* Two pages, from the linker script. */
+extern uint16_t _events_start[];
+
+#define EVENTS_MAGIC 0x4556
+#define RING_MAGIC 0x52494E47
+#define EVENT_HALVES 4
+#define PAGE_HALVES (FLASH_PAGE_SIZE / 2)
+#define PAGE_EVENTS (PAGE_HALVES / EVENT_HALVES) /* slot 0 is the header */
+
+/*
+ * Stored event, in half-words: value, time low, time high, type with
+ * info in the high byte. Type is written last and is never 0xFF, so a
+ * torn event is recognised. Page header: generation, its complement,
+ * unused, magic (written last).
+ */
+
+/* Pending events, kept over a reset. */
+static struct
+{
+    uint32_t magic;
+    uint16_t head; /* oldest pending */
+    uint16_t count;
+    uint16_t ev[EVENTS_RAM][EVENT_HALVES];
+} ring __attribute__((section(".noinit")));
+
+/* What the half-word writer is programming. */
+enum
+{
+    WRITE_EVENT,
+    WRITE_HEADER
+};
+
+static unsigned char active; /* page written now */
+static uint16_t next_slot; /* first free slot of active page */
+static uint16_t generation; /* of active page */
+static uint16_t page_events[2]; /* valid events per page */
+static unsigned char last_type;
+static unsigned char flushing;
+
+static uint16_t wr_buf[EVENT_HALVES];
+static uint16_t* wr_dst;
+static unsigned char wr_pos = EVENT_HALVES;
+static unsigned char wr_kind;
+
+/** 
+ * Helper function. Returns a slot of a page.
+ * 
+ * @param page page number, 0 or 1
+ * @param slot slot number, 0 is the header
+ * 
+ * @return address of the slot
+ */
+static uint16_t* events_slot(unsigned char page, uint16_t slot)
+{
+    return _events_start + page * PAGE_HALVES + slot * EVENT_HALVES;
+}
+
+/** 
+ * Helper function. Checks the page header.
+ * 
+ * @param page page number
+ * 
+ * @return 1 if the page is in use
+ */
+static unsigned char events_page_valid(unsigned char page)
+{
+    uint16_t* h = events_slot(page, 0);
+    return h[3] == EVENTS_MAGIC && (uint16_t)(h[0] ^ h[1]) == 0xFFFF;
+}
+
+/** 
+ * Helper function. Counts valid events of a page and finds its first
+ * free slot.
+ * 
+ * @param page page number
+ * @param free first free slot, PAGE_EVENTS if full
+ * 
+ * @return number of valid events
+ */
+static uint16_t events_scan(unsigned char page, uint16_t* free)
+{
+    uint16_t valid = 0;
+    uint16_t slot;
+    for(slot = 1; slot < PAGE_EVENTS; slot++)
+    {
+        uint16_t* e = events_slot(page, slot);
+        if((e[0] & e[1] & e[2] & e[3]) == 0xFFFF)
+        {
+            break;
+        }
+        if(e[3] != 0xFFFF)
+        {
+            valid++;
+            last_type = e[3];
+        }
+    }
+    *free = slot;
+    return valid;
+}
+
+void events_init(void)
+{
+    if(ring.magic != RING_MAGIC || ring.head >= EVENTS_RAM || ring.count > EVENTS_RAM)
+    {
+        ring.magic = RING_MAGIC;
+        ring.head = 0;
+        ring.count = 0;
+    }
+
+    unsigned char valid0 = events_page_valid(0);
+    unsigned char valid1 = events_page_valid(1);
+    uint16_t free;
+
+    active = 0;
+    if(valid1 && (!valid0 || (int16_t)(events_slot(1, 0)[0] - events_slot(0, 0)[0]) > 0))
+    {
+        active = 1;
+    }
+    page_events[0] = 0;
+    page_events[1] = 0;
+    next_slot = PAGE_EVENTS; /* no page yet, first flush starts one */
+    generation = 0;
+
+    /* Older page first, so last_type ends up from the newest event. */
+    if(active ? valid0 : valid1)
+    {
+        page_events[active ^ 1] = events_scan(active ^ 1, &free);
+    }
+    if(active ? valid1 : valid0)
+    {
+        page_events[active] = events_scan(active, &next_slot);
+        generation = events_slot(active, 0)[0];
+    }
+    if(ring.count != 0)
+    {
+        last_type = ring.ev[(ring.head + ring.count - 1) % EVENTS_RAM][3];
+    }
+}
+
+void events_log(unsigned char type, unsigned char info, uint16_t value)
+{
+    uint32_t now = tick_get();
+    if(ring.count == EVENTS_RAM)
+    {
+        /* Full, drop the oldest. If it is being written, the next one
+         * goes instead: the oldest moves into its place, and finishing
+         * the write removes it from there. */
+        if(wr_pos < EVENT_HALVES && wr_kind == WRITE_EVENT)
+        {
+            uint16_t* second = ring.ev[(ring.head + 1) % EVENTS_RAM];
+            unsigned char i;
+            for(i = 0; i < EVENT_HALVES; i++)
+            {
+                second[i] = ring.ev[ring.head][i];
+            }
+        }
+        ring.head = (ring.head + 1) % EVENTS_RAM;
+        ring.count--;
+    }
+    uint16_t* e = ring.ev[(ring.head + ring.count) % EVENTS_RAM];
+    e[0] = value;
+    e[1] = now;
+    e[2] = now >> 16;
+    e[3] = type | (uint16_t)info << 8;
+    ring.count++;
+    last_type = type;
+}
+
+void events_poll(unsigned char quiet)
+{
+    if(wr_pos < EVENT_HALVES)
+    {
+        flash_program(wr_dst + wr_pos, wr_buf[wr_pos]);
+        if(++wr_pos < EVENT_HALVES)
+        {
+            return;
+        }
+        if(wr_kind == WRITE_EVENT)
+        {
+            ring.head = (ring.head + 1) % EVENTS_RAM;
+            ring.count--;
+            page_events[active]++;
+        }
+        else
+        {
+            active ^= 1;
+            generation++;
+            next_slot = 1;
+        }
+        return;
+    }
+
+    if(ring.count >= EVENTS_BATCH || (quiet && ring.count != 0))
+    {
+        flushing = 1;
+    }
+    if(!flushing || ring.count == 0)
+    {
+        flushing = 0;
+        return;
+    }
+
+    if(next_slot >= PAGE_EVENTS)
+    {
+        if(quiet)
+        {
+            /* Older page is overwritten, header goes first. */
+            flash_erase(events_slot(active ^ 1, 0));
+            page_events[active ^ 1] = 0;
+            wr_buf[0] = generation + 1;
+            wr_buf[1] = ~(generation + 1);
+            wr_buf[2] = 0xFFFF;
+            wr_buf[3] = EVENTS_MAGIC;
+            wr_dst = events_slot(active ^ 1, 0);
+            wr_kind = WRITE_HEADER;
+            wr_pos = 0;
+        }
+        return;
+    }
+
+    unsigned char i;
+    for(i = 0; i < EVENT_HALVES; i++)
+    {
+        wr_buf[i] = ring.ev[ring.head][i];
+    }
+    wr_dst = events_slot(active, next_slot++);
+    wr_kind = WRITE_EVENT;
+    wr_pos = 0;
+}
+
+uint16_t events_count(void)
+{
+    return page_events[0] + page_events[1] + ring.count;
+}
+
+unsigned char events_last(void)
+{
+    return last_type;
+}
+
+/** 
+ * Helper function. Sends one event, little-endian.
+ * 
+ * @param sink function receiving the bytes
+ * @param e event half-words
+ */
+static void events_send(EventSink sink, const uint16_t* e)
+{
+    unsigned char out[2*EVENT_HALVES];
+    out[0] = e[3];
+    out[1] = e[3] >> 8;
+    out[2] = e[0];
+    out[3] = e[0] >> 8;
+    out[4] = e[1];
+    out[5] = e[1] >> 8;
+    out[6] = e[2];
+    out[7] = e[2] >> 8;
+    sink(out, sizeof(out));
+}
+
+void events_dump(EventSink sink)
+{
+    uint16_t count = events_count();
+    unsigned char header[4] = {'E', 1, count, count >> 8};
+    sink(header, sizeof(header));
+
+    unsigned char page = active ^ 1;
+    unsigned char n;
+    for(n = 0; n < 2; n++, page ^= 1)
+    {
+        if(page_events[page] == 0)
+        {
+            continue;
+        }
+        uint16_t slot;
+        for(slot = 1; slot < PAGE_EVENTS; slot++)
+        {
+            uint16_t* e = events_slot(page, slot);
+            if(e[3] != 0xFFFF)
+            {
+                events_send(sink, e);
+            }
+        }
+    }
+
+    uint16_t i;
+    for(i = 0; i < ring.count; i++)
+    {
+        events_send(sink, ring.ev[(ring.head + i) % EVENTS_RAM]);
+    }
+}
@@ -0,0 +1,67 @@
+/**
+ * @file   flash.c
+ * @author Wiktor Gołgowski <wgolgowski@gmail.com>
+ * @date   Tue Oct 20 09:12:44 2026
+ * 
+ * @brief  Programming of the internal flash.
+ * 
+ */
+
+#include "flash.h"
+
+/* Unlock sequence of the flash controller. */
+#define FLASH_KEY1 0x45670123
+#define FLASH_KEY2 0xCDEF89AB
+
+/** 
+ * Helper function. Unlocks the flash controller.
+ * 
+ */
+static void flash_unlock(void)
+{
+    if(FLASH->CR & FLASH_CR_LOCK)
+    {
+        FLASH->KEYR = FLASH_KEY1;
+        FLASH->KEYR = FLASH_KEY2;
+    }
+}
+
+/** 
+ * Helper function. Waits for the end of an operation, clears the
+ * operation bits and locks the controller again.
+ * 
+ * @param op operation bit in CR
+ * 
+ * @return 1 if no error was flagged, 0 otherwise
+ */
+static unsigned char flash_finish(uint32_t op)
+{
+    while(FLASH->SR & FLASH_SR_BSY);
+    FLASH->CR &= ~op;
+    FLASH->CR |= FLASH_CR_LOCK;
+
+    uint32_t sr = FLASH->SR;
+    FLASH->SR = FLASH_SR_EOP | FLASH_SR_PGERR | FLASH_SR_WRPERR;
+    return !(sr & (FLASH_SR_PGERR | FLASH_SR_WRPERR));
+}
+
+unsigned char flash_program(uint16_t* addr, uint16_t value)
+{
+    if(value == 0xFFFF)
+    {
+        return *addr == 0xFFFF;
+    }
+    flash_unlock();
+    FLASH->CR |= FLASH_CR_PG;
+    *(__IO uint16_t*)addr = value;
+    return flash_finish(FLASH_CR_PG) && *addr == value;
+}
+
+unsigned char flash_erase(uint16_t* page)
+{
+    flash_unlock();
+    FLASH->CR |= FLASH_CR_PER;
+    FLASH->AR = (uint32_t)page;
+    FLASH->CR |= FLASH_CR_STRT;
+    return flash_finish(FLASH_CR_PER);
+}
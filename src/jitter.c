@@ -0,0 +1,60 @@
+/**
+ * @file   jitter.c
+ * @author Wiktor Gołgowski <wgolgowski@gmail.com>
+ * @date   Mon Oct 19 14:30:17 2026
+ *
+ * @brief  Commutation edge jitter statistics. Edges are timestamped
+ * with SysTick resolution (one core clock cycle).
+ *
+ */
+
+#include "jitter.h"
+#include "delay.h"
+
+JitterStats jitter;
+
+static uint32_t last_stamp; /* timestamp of the previous edge */
+static uint32_t last_period; /* period scheduled at previous edge, 0 if none */
+
+void jitter_reset(void)
+{
+    unsigned char i;
+    for(i = 0; i < JITTER_BINS; i++)
+    {
+        jitter.bins[i] = 0;
+    }
+    jitter.samples = 0;
+    jitter.worst_us = 0;
+    last_period = 0;
+}
+
+void jitter_edge(uint32_t period_ms)
+{
+    uint32_t now = cycle_get();
+
+    if(period_ms != 0 && period_ms == last_period)
+    {
+        uint32_t ideal = period_ms * (SysTick->LOAD + 1);
+        uint32_t interval = now - last_stamp;
+        uint32_t dev = interval > ideal ? interval - ideal : ideal - interval;
+        dev /= SystemCoreClock / 1000000;
+
+        if(dev > jitter.worst_us)
+        {
+            jitter.worst_us = dev;
+        }
+
+        /* Logarithmic bins, no division needed. */
+        unsigned char bin = 0;
+        while(dev != 0 && bin < JITTER_BINS-1)
+        {
+            dev >>= 1;
+            bin++;
+        }
+        jitter.bins[bin]++;
+        jitter.samples++;
+    }
+
+    last_stamp = now;
+    last_period = period_ms;
+}
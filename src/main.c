@@ -13,452 +13,982 @@
 #include "delay.h"
 #include "pt6961.h"
 #include "gpiopin.h"
+#include "jitter.h"
+#include "menu.h"
+#include "ambient.h"
+#include "scroll.h"
+#include "sched.h"
+#include "params.h"
+#include "events.h"
+#include "watchdog.h"
+#include "serial.h"
+#include "crc32.h"
+#include "engine.h"
+#if PROTOCOL_MODBUS
+#include "modbus.h"
+#include "rtu.h"
+#else
+#include "command.h"
+#include "telemetry.h"
+#endif
 
 
-static __IO uint32_t DelayCounter; /* for busy wait */
-static __IO uint32_t phase_counter; /* for phase change */
-static __IO uint32_t blink_counter; /* for display blinking */
 static __IO uint32_t key_debouncer; /* for key presses management */
+static PT6961_Bus* __IO key_bus; /* scanned from SysTick once set */
 
 
-#define PHASES 6
 #define BOUNCER 200
-#define BLINK_MS 300
 
+/* Number of drives, each with its own power stage. */
+#ifndef ENGINE_COUNT
+#define ENGINE_COUNT 1
+#endif
 
-typedef struct strEngine
+/**
+ * Pin maps of the drives, in flash, so engine_safe_outputs can read
+ * them before RAM is set up. A second drive (two small fans) uses
+ * PB10-PB15 and the fault input on PA11.
+ */
+static const EnginePins engine_pins[ENGINE_COUNT] =
 {
-    uint32_t state;
-    uint32_t rotation;
-    uint32_t requested_rotation;
-    uint32_t duration;
-    unsigned char phase; /* 0-5, 60° phase */
-    unsigned char direction; /* 1 - right, 0 - left */
-    unsigned char requested_direction;
-    unsigned char started;
-    unsigned char fault_overcurrent;
-    
-} Engine;
+    {{{GPIOC, 6}, {GPIOC, 7}, {GPIOC, 8}, {GPIOC, 9}, {GPIOA, 8}, {GPIOA, 9}}, {GPIOA, 10}},
+#if ENGINE_COUNT > 1
+    {{{GPIOB, 10}, {GPIOB, 11}, {GPIOB, 12}, {GPIOB, 13}, {GPIOB, 14}, {GPIOB, 15}}, {GPIOA, 11}},
+#endif
+};
+
+static Engine drives[ENGINE_COUNT];
 
-Engine engine;
+/* Drive shown and commanded by the keypad and the serial port, the
+ * other drives follow its setpoint. */
+static Engine* const engine = &drives[0];
+
+/**
+ * Helper function. Packs engine state and phase for the event log.
+ *
+ * @param e pointer to drive state
+ *
+ * @return state in the high nibble, phase in the low one
+ */
+static unsigned char engine_info(const Engine* e)
+{
+    return (e->state << 4) | e->phase;
+}
 
-void engine_next_phase_cb()
+/**
+ * Helper function. Checks if no drive is rotating or started.
+ *
+ * @return 1 if all drives are stopped
+ */
+static unsigned char drives_stopped(void)
 {
-    if(engine.direction == 1) //right
+    unsigned char i;
+    for(i = 0; i < ENGINE_COUNT; i++)
     {
-        if(engine.phase < PHASES-1)
-        {
-            engine.phase++;
-        }
-        else
-        {
-            engine.phase = 0;
-        }
+        if(drives[i].rotation != 0 || drives[i].started)
+            return 0;
     }
-    else
+    return 1;
+}
+
+void DelayMs_Decrement(void)
+{
+    uint32_t ms = tick_increment(); /* more than one after tickless sleep */
+
+    while(ms-- != 0)
     {
-        if(engine.phase == 0)
+        engine_tick(drives, ENGINE_COUNT);
+
+        if(key_debouncer != 0)
         {
-            engine.phase = PHASES-1;
+            key_debouncer--;
         }
-        else
+
+        if(key_bus != 0)
         {
-            engine.phase--;
+            pt6961_bus_tick(key_bus);
         }
     }
+    watchdog_checkin(WDG_TICK);
 }
 
-void engine_set_phase_delay(uint32_t delay)
+/**
+ * This function drives all transistor outputs low. It is called first
+ * in Reset_Handler, before .data and .bss are set up, so it must not
+ * use any variables.
+ */
+void engine_safe_outputs(void)
 {
-    phase_counter = delay;
+    unsigned char i;
+    for(i = 0; i < ENGINE_COUNT; i++)
+    {
+        engine_pins_safe(&engine_pins[i]);
+    }
 }
 
-void DelayMs_Decrement(void)
+
+unsigned char key_handler(PT6961_Init* pt, unsigned char key)
 {
-    if(DelayCounter != 0x00)
+    key = pt6961_bus_key(pt->bus, 0);
+    if(key_debouncer > 0)
+    {
+        return KEY_NONE;
+    }
+    else
     {
-        DelayCounter--;
+        if(key != 0)
+            key_debouncer = BOUNCER;
+        return key;
     }
+}
 
-    if(phase_counter != 0)
+unsigned char gpio_reader(GPIO_TypeDef* port, uint32_t pin)
+{
+    unsigned char data = gpio_get(port, pin);
+    if(key_debouncer > 0)
     {
-        phase_counter--;
+        return 0;
     }
     else
     {
-        engine_next_phase_cb();
-        phase_counter = engine.duration;
+        key_debouncer = BOUNCER;
+        return data;
     }
+}
 
-    if(key_debouncer != 0)
-    {
-        key_debouncer--;
-    }
+#define ROT_MAX 1000
+#define ROT_MIN 0
+#define ADDRESS_MAX 247 /* highest drive address */
+
+/** 
+ * Helper function. Limits a stored rotation to the allowed range.
+ * 
+ * @param value rotation
+ * 
+ * @return rotation within ROT_MIN and ROT_MAX
+ */
+static uint32_t rotation_limit(int32_t value)
+{
+    if(value < ROT_MIN)
+        return ROT_MIN;
+    if(value > ROT_MAX)
+        return ROT_MAX;
+    return value;
+}
+
+static uint32_t selected_rotation = 0;
+static unsigned char selected_direction = 0;
+static PT6961_Init* display; /* for brightness pages, 0 until powered up */
+static PT6961_Init* display_pending; /* powered up by task_ui */
+static uint32_t idle_cycles; /* slept since last diagnostics update */
+static uint32_t idle_percent; /* CPU time slept over last second */
+static unsigned char image_bad; /* checksum mismatch, engine stays off */
+#if PROTOCOL_MODBUS
+static ModbusSlave modbus;
+#else
+static CommandPort command_port;
+#endif
+
+/* Getters and commit callbacks for menu pages. */
+
+static int32_t get_rotation(void)
+{
+    return engine->rotation;
+}
+
+static int32_t get_u_voltage(void)
+{
+    return 230;
+}
+
+static int32_t get_v_voltage(void)
+{
+    return 229;
+}
+
+static int32_t get_w_voltage(void)
+{
+    return 235;
+}
+
+static int32_t get_u_current(void)
+{
+    return engine->started ? 109 : 0;
+}
+
+static int32_t get_v_current(void)
+{
+    return engine->started ? 111 : 0;
+}
+
+static int32_t get_w_current(void)
+{
+    return engine->started ? 113 : 0;
+}
+
+static int32_t get_fault(void)
+{
+    return engine->fault_overcurrent;
+}
+
+static int32_t get_direction(void)
+{
+    return engine->direction;
+}
+
+static int32_t get_requested_rotation(void)
+{
+    return engine->requested_rotation;
+}
+
+static int32_t get_jitter(void)
+{
+    return jitter.worst_us / 100;
+}
+
+static int32_t get_idle(void)
+{
+    return idle_percent;
+}
+
+static int32_t get_events(void)
+{
+    return events_count();
+}
+
+static int32_t get_last_event(void)
+{
+    return events_last();
+}
+
+static int32_t get_selected_rotation(void)
+{
+    return selected_rotation;
+}
+
+static int32_t get_selected_direction(void)
+{
+    return selected_direction;
+}
+
+static int32_t get_address(void)
+{
+#if PROTOCOL_MODBUS
+    return modbus.address;
+#else
+    return command_port.address;
+#endif
+}
+
+static int32_t get_brightness(void)
+{
+    return display ? display->fade_target : 0;
+}
+
+static int32_t get_auto_dimming(void)
+{
+    return ambient_enabled();
+}
+
+static void toggle_direction(int32_t value)
+{
+    engine->requested_direction = !engine->requested_direction;
+    params_set(PARAM_REQUESTED_DIRECTION, engine->requested_direction);
+}
+
+static void clear_jitter(int32_t value)
+{
+    jitter_reset();
+}
+
+static void set_rotation(int32_t value)
+{
+    selected_rotation = value;
+    engine->requested_rotation = value;
+    params_set(PARAM_REQUESTED_ROTATION, value);
+}
+
+static void set_direction(int32_t value)
+{
+    selected_direction = value;
+    engine->requested_direction = value;
+    params_set(PARAM_REQUESTED_DIRECTION, value);
+}
+
+static void set_address(int32_t value)
+{
+#if PROTOCOL_MODBUS
+    modbus.address = value;
+#else
+    command_port.address = value;
+#endif
+    params_set(PARAM_ADDRESS, value);
+}
+
+static void set_brightness(int32_t value)
+{
+    ambient_enable(0);
+    if(display != 0)
+        pt6961_set_brightness(display, value);
+}
+
+static void set_auto_dimming(int32_t value)
+{
+    ambient_enable(value);
+}
+
+/// Display mode pages, OK toggles direction.
+static const MenuPage display_pages[] =
+{
+    /* getter                  commit            min  max      step format              editor */
+    {get_rotation,             toggle_direction, 0,   0,       0,   MENU_FMT_INT,       MENU_EDIT_NONE},
+    {get_u_voltage,            toggle_direction, 0,   0,       0,   MENU_FMT_INT,       MENU_EDIT_NONE},
+    {get_v_voltage,            toggle_direction, 0,   0,       0,   MENU_FMT_INT,       MENU_EDIT_NONE},
+    {get_w_voltage,            toggle_direction, 0,   0,       0,   MENU_FMT_INT,       MENU_EDIT_NONE},
+    {get_u_current,            toggle_direction, 0,   0,       0,   MENU_FMT_FIXED1,    MENU_EDIT_NONE}, /* 0.1 A */
+    {get_v_current,            toggle_direction, 0,   0,       0,   MENU_FMT_FIXED1,    MENU_EDIT_NONE},
+    {get_w_current,            toggle_direction, 0,   0,       0,   MENU_FMT_FIXED1,    MENU_EDIT_NONE},
+    {get_fault,                toggle_direction, 0,   0,       0,   MENU_FMT_INT,       MENU_EDIT_NONE}, /* last uncleared */
+    {get_direction,            toggle_direction, 0,   0,       0,   MENU_FMT_DIRECTION, MENU_EDIT_NONE},
+    {get_requested_rotation,   toggle_direction, 0,   0,       0,   MENU_FMT_INT,       MENU_EDIT_NONE},
+    {get_jitter,               clear_jitter,     0,   0,       0,   MENU_FMT_FIXED1,    MENU_EDIT_NONE}, /* worst, ms */
+    {get_idle,                 toggle_direction, 0,   0,       0,   MENU_FMT_INT,       MENU_EDIT_NONE}, /* % */
+    {get_events,               toggle_direction, 0,   0,       0,   MENU_FMT_INT,       MENU_EDIT_NONE}, /* logged */
+    {get_last_event,           toggle_direction, 0,   0,       0,   MENU_FMT_INT,       MENU_EDIT_NONE}, /* EVENT_* */
+};
 
-    if(blink_counter == 0)
+/// Program mode pages.
+static const MenuPage program_pages[] =
+{
+    {get_selected_rotation,    set_rotation,     ROT_MIN, ROT_MAX, 10, MENU_FMT_INT,    MENU_EDIT_STEP},
+    {get_selected_direction,   set_direction,    0,   1,       1,   MENU_FMT_DIRECTION, MENU_EDIT_TOGGLE},
+    {get_brightness,           set_brightness,   0,   PT_BRIGHTNESS_MAX, 1, MENU_FMT_INT, MENU_EDIT_STEP},
+    {get_auto_dimming,         set_auto_dimming, 0,   1,       1,   MENU_FMT_INT,       MENU_EDIT_TOGGLE},
+    {get_address,              set_address,      1,   ADDRESS_MAX, 1, MENU_FMT_INT,     MENU_EDIT_STEP}, /* command protocol */
+};
+
+static const MenuGroup menu_groups[] =
+{
+    {display_pages, sizeof(display_pages) / sizeof(display_pages[0]), 'd', 'f'},
+    {program_pages, sizeof(program_pages) / sizeof(program_pages[0]), 'p', 'p'},
+};
+
+static Menu menu;
+
+/** 
+ * Helper function. Starts the engine with the requested rotation, or
+ * the selected one if none is requested.
+ */
+static void engine_start(void)
+{
+    if(image_bad)
+        return;
+    if(engine->requested_rotation == 0)
     {
-        blink_counter = BLINK_MS;
+        engine->requested_rotation = selected_rotation;
+        params_set(PARAM_REQUESTED_ROTATION, selected_rotation);
     }
-    else
+    if(engine->requested_rotation > 0)
+        engine->started = 1;
+}
+
+/** 
+ * Helper function. Stops the engine and clears the fault of every
+ * drive.
+ */
+static void engine_stop(void)
+{
+    unsigned char i;
+    for(i = 0; i < ENGINE_COUNT; i++)
     {
-        blink_counter--;
+        Engine* e = &drives[i];
+        if(e->fault_overcurrent)
+        {
+            events_log(EVENT_FAULT_CLEARED, engine_info(e), e->rotation);
+        }
+        e->started = 0;
+        e->fault_overcurrent = 0;
     }
-    
 }
 
-/// Configuration for the transistors (last two bits do not matter)
-unsigned char phase_configuration[PHASES] = {0b00100001, 0b00000011, 0b00000110, 0b00001100, 0b00011000, 0b00110000};
-GPIOPin T[PHASES];
-
-void engine_init_pins()
+void handle_keys(unsigned char key)
 {
-    T[0] = gpiopin(GPIOC, 6);
-    T[1] = gpiopin(GPIOC, 7);
-    T[2] = gpiopin(GPIOC, 8);
-    T[3] = gpiopin(GPIOC, 9);
-    T[4] = gpiopin(GPIOA, 8);
-    T[5] = gpiopin(GPIOA, 9);
-    /* Configure them as outputs: */
-    T[0].port->MODER |= 1 << (T[0].pin * 2);
-    T[1].port->MODER |= 1 << (T[1].pin * 2);
-    T[2].port->MODER |= 1 << (T[2].pin * 2);
-    T[3].port->MODER |= 1 << (T[3].pin * 2);
-    T[4].port->MODER |= 1 << (T[4].pin * 2);
-    T[5].port->MODER |= 1 << (T[5].pin * 2);
+    if(!menu_key(&menu, key))
+    {
+        switch(key)
+        {
+        case KEY_START:
+            engine_start();
+            break;
 
-    
+        case KEY_STOP:
+            engine_stop();
+            break;
+
+        default: /* KEY_NONE */
+            break;
+        }
+    }
 }
 
-void engine_set_pins_to_phase(unsigned char phase)
+void handle_ui(PT6961_Init* pt)
 {
-    unsigned char cfg;
-    if(engine.rotation == 0)
+    /* Fault description scrolls until the fault is cleared by STOP. */
+    static unsigned char fault_msg = SCROLL_NONE;
+    if(engine->fault_overcurrent && fault_msg == SCROLL_NONE)
+    {
+        fault_msg = scroll_post(SCROLL_FAULT, "fault - overcurrent, press stop", 0);
+    }
+    else if(!engine->fault_overcurrent && fault_msg != SCROLL_NONE)
+    {
+        scroll_cancel(fault_msg);
+        fault_msg = SCROLL_NONE;
+    }
+
+    /* Status LEDs, only changes reach the display. */
+    pt6961_indicator(pt, PT_LED_RUNNING, engine->rotation != 0);
+    pt6961_indicator(pt, PT_LED_FAULT, engine->fault_overcurrent);
+    pt6961_indicator(pt, PT_LED_DIRECTION, engine->direction);
+    pt6961_indicator(pt, PT_LED_PROGRAM, menu.group != 0);
+
+    menu.alert = engine->fault_overcurrent;
+    if(scroll_poll(pt))
     {
-        cfg = 0;
+        menu_invalidate(&menu); /* redraw when message is gone */
     }
     else
     {
-        cfg = phase_configuration[phase];
+        menu_render(&menu, pt);
     }
-    
+    pt6961_effects(pt);
+}
+
+
+/* Scheduled tasks, in order of priority. */
+
+enum
+{
+    TASK_FAULT,
+    TASK_ENGINE,
+    TASK_KEYS,
+    TASK_STORE,
+    TASK_COMMAND,
+    TASK_UI,
+    TASK_WATCHDOG,
+    TASK_DIAG,
+    TASK_COUNT
+};
+
+static SchedTask tasks[TASK_COUNT];
+
+static void task_fault(void)
+{
     unsigned char i;
-    for(i = 0; i < PHASES; i++)
+    for(i = 0; i < ENGINE_COUNT; i++)
     {
-        if((cfg & (1 << i)) == 0)
+        Engine* e = &drives[i];
+        if(engine_fault(e))
         {
-            gpiopin_clear(T[i]);
+            if(!e->fault_overcurrent)
+            {
+                events_log(EVENT_OVERCURRENT, engine_info(e), e->rotation);
+            }
+            e->fault_overcurrent = 1;
+            engine_handle(e, ENGINE_EV_FAULT);
         }
-        else
+    }
+}
+
+static void task_engine(void)
+{
+    unsigned char i;
+
+    watchdog_checkin(WDG_ENGINE);
+
+    for(i = 0; i < ENGINE_COUNT; i++)
+    {
+        Engine* e = &drives[i];
+        if(i != 0)
         {
-            gpiopin_set(T[i]);
+            /* Followers run in parallel with the first drive. */
+            e->requested_rotation = engine->requested_rotation;
+            e->requested_direction = engine->requested_direction;
+            e->started = engine->started;
+        }
+        engine_handle(e, engine_event(e));
+
+        /* Change output pins configuration */
+        if(engine_output(e) && i == 0)
+        {
+            /* Pattern changes, measure how late (or early) it is. */
+            jitter_edge(e->pattern != ENGINE_PHASES ? e->duration : 0);
         }
     }
 }
 
-void DelayMs(__IO uint32_t ms)
+static void task_keys(void)
 {
-    DelayCounter = ms;
-    while(DelayCounter != 0x00);
+    watchdog_checkin(WDG_KEYS);
+    if(display != 0)
+        handle_keys(key_handler(display, 0));
 }
 
+/** 
+ * Helper function. Powers the display up, a step per call, so the
+ * other tasks run during the chip power-up. When it is on, the
+ * greeting is shown and the key scan starts.
+ */
+static void display_start(void)
+{
+    if(pt6961_start(display_pending) != CORO_DONE)
+        return;
 
+    display = display_pending;
+    pt6961_update(display);
+    pt6961_bus_flush(display->bus);
+    key_bus = display->bus;
+    if(image_bad)
+        scroll_post(SCROLL_FAULT, "firmware checksum error", 0);
+    else
+        scroll_post(SCROLL_STATUS, "bldc driver ready", 1);
+}
 
-void delay (int a);
-
-unsigned char key_handler(PT6961_Init* pt, unsigned char key)
+static void task_ui(void)
 {
-    key = pt6961_read(pt);
-    if(key_debouncer > 0)
+    if(display == 0)
     {
-        return KEY_NONE;
+        display_start();
+        return;
     }
-    else
+    handle_ui(display);
+    ambient_poll(display);
+    pt6961_bus_flush(key_bus);
+}
+
+static void task_store(void)
+{
+    params_set(PARAM_SELECTED_ROTATION, selected_rotation);
+    params_set(PARAM_SELECTED_DIRECTION, selected_direction);
+    /* The setpoint is stored where the operator changes it, the engine
+     * zeroes it on its own while braking and on faults. */
+    /* Page erase stalls the CPU, only with the engine stopped. */
+    params_poll(drives_stopped());
+    events_poll(drives_stopped());
+}
+
+static void task_watchdog(void)
+{
+    watchdog_poll();
+}
+
+#if !PROTOCOL_MODBUS
+
+/* Command handlers. Parameters are menu pages, id is group << 4 | page,
+ * and are written with the same limits as from the keypad. */
+
+#define COMMAND_VERSION 1
+#define COMMAND_EVENTS_MAX 8 /* events per reply */
+
+/** 
+ * Helper function. Takes a snapshot of the engine for COMMAND_STATS.
+ * 
+ * @param t record to fill
+ */
+static void telemetry_fill(Telemetry* t)
+{
+    uint32_t overruns = 0;
+    unsigned char i;
+
+    t->time_ms = tick_get();
+    t->state = engine->state;
+    t->phase = engine->phase;
+    t->flags = (engine->fault_overcurrent ? TELEMETRY_FAULT : 0)
+        | (engine->started ? TELEMETRY_STARTED : 0)
+        | (engine->direction ? TELEMETRY_DIRECTION : 0);
+    t->idle_percent = idle_percent;
+    t->requested_rpm = engine->requested_rotation;
+    t->rpm = engine->rotation;
+    t->current[0] = get_u_current();
+    t->current[1] = get_v_current();
+    t->current[2] = get_w_current();
+    t->jitter_us = jitter.worst_us > 0xFFFF ? 0xFFFF : jitter.worst_us;
+    for(i = 0; i < TASK_COUNT; i++)
     {
-        key_debouncer = BOUNCER;
-        return key;
+        overruns += tasks[i].overruns;
     }
+    t->overruns = overruns;
 }
 
-unsigned char gpio_reader(GPIO_TypeDef* port, uint32_t pin)
+static uint16_t command_get16(const unsigned char* p)
 {
-    unsigned char data = gpio_get(port, pin);
-    if(key_debouncer > 0)
-    {
+    return p[0] | (p[1] << 8);
+}
+
+static void command_put32(unsigned char* p, uint32_t value)
+{
+    p[0] = value;
+    p[1] = value >> 8;
+    p[2] = value >> 16;
+    p[3] = value >> 24;
+}
+
+/** 
+ * Helper function. Finds the menu page of a parameter id.
+ * 
+ * @param id group in the high nibble, page in the low one
+ * 
+ * @return page, 0 if none
+ */
+static const MenuPage* command_page(unsigned char id)
+{
+    unsigned char group = id >> 4;
+    unsigned char page = id & 0x0F;
+    if(group >= sizeof(menu_groups) / sizeof(menu_groups[0]) || page >= menu_groups[group].count)
         return 0;
-    }
-    else
+    return &menu_groups[group].pages[page];
+}
+
+static int16_t cmd_ping(const unsigned char* arg, uint16_t len, unsigned char* reply)
+{
+    reply[0] = COMMAND_VERSION;
+    return 1;
+}
+
+static int16_t cmd_read(const unsigned char* arg, uint16_t len, unsigned char* reply)
+{
+    if(len != 1)
+        return -COMMAND_BAD_LENGTH;
+    const MenuPage* page = command_page(arg[0]);
+    if(page == 0)
+        return -COMMAND_BAD_ID;
+    command_put32(reply, page->get());
+    return 4;
+}
+
+static int16_t cmd_write(const unsigned char* arg, uint16_t len, unsigned char* reply)
+{
+    if(len != 5)
+        return -COMMAND_BAD_LENGTH;
+    const MenuPage* page = command_page(arg[0]);
+    if(page == 0)
+        return -COMMAND_BAD_ID;
+    if(page->editor == MENU_EDIT_NONE)
+        return -COMMAND_READ_ONLY;
+    int32_t value = command_get16(arg + 1) | ((uint32_t)command_get16(arg + 3) << 16);
+    if(value < page->min || value > page->max)
+        return -COMMAND_RANGE;
+    page->commit(value);
+    menu_invalidate(&menu);
+    command_put32(reply, page->get());
+    return 4;
+}
+
+static int16_t cmd_start(const unsigned char* arg, uint16_t len, unsigned char* reply)
+{
+    engine_start();
+    return 0;
+}
+
+static int16_t cmd_stop(const unsigned char* arg, uint16_t len, unsigned char* reply)
+{
+    engine_stop();
+    return 0;
+}
+
+static int16_t cmd_reverse(const unsigned char* arg, uint16_t len, unsigned char* reply)
+{
+    toggle_direction(0);
+    return 0;
+}
+
+/* Event log window copied by events_copy. */
+static unsigned char* events_out;
+static uint16_t events_first;
+static uint16_t events_index; /* chunk, header is zero */
+static unsigned char events_copied;
+
+/** 
+ * Helper function. Event log sink, copies events from events_first.
+ * 
+ * @param data header or one event
+ * @param len number of bytes
+ */
+static void events_copy(const unsigned char* data, uint16_t len)
+{
+    uint16_t i;
+    if(events_index > events_first && events_copied < COMMAND_EVENTS_MAX)
     {
-        key_debouncer = BOUNCER;
-        return data;
+        for(i = 0; i < len; i++)
+        {
+            *events_out++ = data[i];
+        }
+        events_copied++;
     }
+    events_index++;
 }
 
-#define ROT_MAX 1000
-#define ROT_MIN 0
+static int16_t cmd_events(const unsigned char* arg, uint16_t len, unsigned char* reply)
+{
+    if(len != 2)
+        return -COMMAND_BAD_LENGTH;
+    uint16_t count = events_count();
+    reply[0] = count;
+    reply[1] = count >> 8;
+    events_out = reply + 2;
+    events_first = command_get16(arg);
+    events_index = 0;
+    events_copied = 0;
+    events_dump(events_copy);
+    return events_out - reply;
+}
+
+static int16_t cmd_stats(const unsigned char* arg, uint16_t len, unsigned char* reply)
+{
+    Telemetry t;
+    telemetry_fill(&t);
+    telemetry_pack(reply, &t);
+    reply += TELEMETRY_RECORD_LEN;
+    reply[0] = command_port.errors;
+    reply[1] = command_port.errors >> 8;
+    return TELEMETRY_RECORD_LEN + 2;
+}
 
-void handle_menu(PT6961_Init* pt, unsigned char key)
+static const Command commands[] =
 {
-    char disp_mode_max = 9;
-    char prog_mode_max = 2;
-    static uint32_t selected_rotation = 0;
-    static unsigned char selected_direction = 0;
-    static unsigned char cur_id = 0; /* Current parameter ID. */
-    static unsigned char mode = 0; /* Current mode. 0 - display, 1 - program */
-    if(mode == 0)
+    {COMMAND_PING, cmd_ping},
+    {COMMAND_READ, cmd_read},
+    {COMMAND_WRITE, cmd_write},
+    {COMMAND_START, cmd_start},
+    {COMMAND_STOP, cmd_stop},
+    {COMMAND_REVERSE, cmd_reverse},
+    {COMMAND_EVENTS, cmd_events},
+    {COMMAND_STATS, cmd_stats}
+};
+
+static void task_command(void)
+{
+    const unsigned char* data;
+    uint16_t len;
+
+    /* Twice, the unread bytes may wrap around the ring. */
+    unsigned char i;
+    for(i = 0; i < 2; i++)
     {
-        switch(key)
-        {
-        case KEY_ESC:
-            mode = 1;
-            cur_id = 0;
-            return;
-
-        case KEY_UP:
-            if(cur_id < disp_mode_max)
-                cur_id++;
-            else
-                cur_id = 0;
+        len = serial_peek(&data);
+        uint16_t used = command_feed(&command_port, data, len);
+        serial_skip(used);
+        if(used < len || len == 0)
             break;
+    }
+}
 
-        case KEY_DOWN:
-            if(cur_id == 0)
-                cur_id = disp_mode_max;
-            else
-                cur_id--;
-            break;
+#else
 
-        case KEY_START:
-            if(engine.requested_rotation == 0)
-            {
-                engine.requested_rotation = selected_rotation;
-            }
-            if(engine.requested_rotation > 0)
-                engine.started = 1;
-            break;
+/* Modbus registers, address is the index in the table. */
 
-        case KEY_STOP:
-            engine.started = 0;
-            engine.fault_overcurrent = 0;
-            break;
-            
-        case KEY_OK:
-            engine.requested_direction = !engine.requested_direction;
-            break;
-            
-        default: /* KEY_NONE */
-            break;
-        }
-        char st = 'd'; // for display
-        if(engine.fault_overcurrent == 1)
-        {
-            st = 'f'; // for fault signalization
-        }
-        switch(cur_id)
-        {
-        case 0: /* current rotation */
-            snprintf(pt->value, PT_LEN+1, "%c%d%d", st, cur_id, engine.rotation);
-            pt6961_update(pt);
-            break;
-        case 1: /* U phase voltage */
-            snprintf(pt->value, PT_LEN+1, "%c%d%d", st, cur_id, 230);
-            pt6961_update(pt);
-            break;
-        case 2: /* V phase voltage */
-            snprintf(pt->value, PT_LEN+1, "%c%d%d", st, cur_id, 229);
-            pt6961_update(pt);
-            break;
-        case 3: /* W phase voltage */
-            snprintf(pt->value, PT_LEN+1, "%c%d%d", st, cur_id, 235);
-            pt6961_update(pt);
-            break;
-        case 4: /* U phase current */
-            if(engine.started)
-                snprintf(pt->value, PT_LEN+1, "%c%d%s", st, cur_id, "10.9");
-            else
-                snprintf(pt->value, PT_LEN+1, "%c%d%s", st, cur_id, "  0");
-            pt6961_update(pt);
-            break;
-        case 5: /* V phase current */
-            if(engine.started)
-                snprintf(pt->value, PT_LEN+1, "%c%d%s", st, cur_id, "11.1");
-            else
-                snprintf(pt->value, PT_LEN+1, "%c%d%s", st, cur_id, "  0");
-            pt6961_update(pt);
-            break;
-        case 6: /* W phase current */
-            if(engine.started)
-                snprintf(pt->value, PT_LEN+1, "%c%d%s", st, cur_id, "11.3");
-            else
-                snprintf(pt->value, PT_LEN+1, "%c%d%s", st, cur_id, "  0");
-            pt6961_update(pt);
-            break;
-        case 7: /* Last uncleared fault */
-            if(engine.fault_overcurrent)
-            {
-                
-                snprintf(pt->value, PT_LEN+1, "%c%d%s", st, cur_id, "1");
-            }
-            else
-            {
-                snprintf(pt->value, PT_LEN+1, "%c%d%s", st, cur_id, "0");
-            }
-            pt6961_update(pt);
-            break;
-        case 8: /* Direction */
-            snprintf(pt->value, PT_LEN+1, "%c%d%c", st, cur_id, engine.direction?'r':'l');
-            pt6961_update(pt);
-            break;
+static uint16_t reg_requested_rotation(void)
+{
+    return engine->requested_rotation;
+}
 
-        case 9: /* Requested rotation */
-            snprintf(pt->value, PT_LEN+1, "%c%d%d", st, cur_id, engine.requested_rotation);
-            pt6961_update(pt);
-            break;
-            
-        default:
-            break;
-        }
+static unsigned char set_requested_rotation(uint16_t value)
+{
+    if(value > ROT_MAX)
+        return 0;
+    engine->requested_rotation = value;
+    params_set(PARAM_REQUESTED_ROTATION, value);
+    return 1;
+}
+
+static uint16_t reg_requested_direction(void)
+{
+    return engine->requested_direction;
+}
+
+static unsigned char set_requested_direction(uint16_t value)
+{
+    if(value > 1)
+        return 0;
+    engine->requested_direction = value;
+    params_set(PARAM_REQUESTED_DIRECTION, value);
+    return 1;
+}
+
+static uint16_t reg_started(void)
+{
+    return engine->started;
+}
+
+static unsigned char set_started(uint16_t value)
+{
+    if(value > 1)
+        return 0;
+    if(value)
+        engine_start();
+    else
+        engine_stop();
+    return 1;
+}
+
+static uint16_t reg_state(void)
+{
+    return engine->state;
+}
+
+static uint16_t reg_rotation(void)
+{
+    return engine->rotation;
+}
+
+static uint16_t reg_u_current(void)
+{
+    return get_u_current();
+}
+
+static uint16_t reg_v_current(void)
+{
+    return get_v_current();
+}
+
+static uint16_t reg_w_current(void)
+{
+    return get_w_current();
+}
+
+static uint16_t reg_faults(void)
+{
+    return engine->fault_overcurrent; /* bit 0: overcurrent */
+}
+
+static const ModbusRegister holding_registers[] =
+{
+    {reg_requested_rotation,   set_requested_rotation},   /* 0: RPM */
+    {reg_requested_direction,  set_requested_direction},  /* 1: 1 - right */
+    {reg_started,              set_started}               /* 2: 1 - start, 0 - stop and clear fault */
+};
+
+static const ModbusRegister input_registers[] =
+{
+    {reg_state,                0},  /* 0 */
+    {reg_rotation,             0},  /* 1: RPM */
+    {reg_u_current,            0},  /* 2: 0.1 A */
+    {reg_v_current,            0},  /* 3 */
+    {reg_w_current,            0},  /* 4 */
+    {reg_faults,               0}   /* 5 */
+};
+
+/* Frame length is measured by unread bytes in the ring, so a frame
+ * as long as the ring would read as empty. */
+#if MODBUS_ADU_MAX >= SERIAL_RX_SIZE
+#error "Modbus frames must be shorter than the serial receive ring"
+#endif
+
+static void task_command(void)
+{
+    static unsigned char request[MODBUS_ADU_MAX];
+    static unsigned char reply[2][MODBUS_ADU_MAX];
+    static unsigned char fill;
+
+    /* A frame waits in the ring while the previous reply is queued. */
+    if(!serial_ready())
+    {
+        return;
     }
-    else /* mode == 1 (program) */
+    uint16_t len = rtu_frame(request, sizeof(request));
+    if(len == 0)
     {
-        static char program_mode = 0;
+        return;
+    }
+    len = modbus_frame(&modbus, request, len, reply[fill]);
+    if(len != 0)
+    {
+        serial_send(reply[fill], len);
+        fill ^= 1;
+    }
+}
 
-        
-        switch(cur_id)
-        {
-        case 0: /* set rotation */
-            if(blink_counter < BLINK_MS/2 || program_mode == 0)
-            {
-                snprintf(pt->value, PT_LEN+1, "p%d%d", cur_id, selected_rotation);
-            }
-            else
-            {
-                snprintf(pt->value, PT_LEN+1, "  %d", selected_rotation);
-            }
-            pt6961_update(pt);
-            if(program_mode)
-            {
-                switch(key)
-                {
-                case KEY_UP:
-                    if(selected_rotation < ROT_MAX)
-                        selected_rotation += 10;
-                    break;
-                case KEY_DOWN:
-                    if(selected_rotation > ROT_MIN)
-                    {
-                        selected_rotation -= 10;
-                    }
-                    break;
-                case KEY_OK:
-                    engine.requested_rotation = selected_rotation;
-                    program_mode = 0;
-                default:
-                    break;
-                
-                }
-            }
-            else
-            {
-            
-                switch(key)
-                {
-                case KEY_UP:
-                    if(cur_id < prog_mode_max-1)
-                        cur_id++;
-                    else
-                        cur_id = 0;
-                    break;
-
-                case KEY_DOWN:
-                    if(cur_id > 0)
-                        cur_id--;
-                    else
-                        cur_id = prog_mode_max - 1;
-                    break;
-                        
-                case KEY_OK:
-                    program_mode = 1;
-                    break;
-
-                case KEY_ESC:
-                    mode = 0;
-                    cur_id = 0;
-                    break;
-
-                default:
-                    break;
-                        
-                }
-            }
-            break;
+#endif
 
-        case 1: /* set direction */
-            if(blink_counter < BLINK_MS/2 || program_mode == 0)
-            {
-                snprintf(pt->value, PT_LEN+1, "p%d%c", cur_id, selected_direction?'r':'l');
-            }
-            else
-            {
-                snprintf(pt->value, PT_LEN+1, "  %c", selected_direction?'r':'l');
-            }
-            pt6961_update(pt);
-            if(program_mode)
-            {
-                switch(key)
-                {
-                case KEY_UP:
-                case KEY_DOWN:
-                    selected_direction = !selected_direction;
-                    break;
-                case KEY_OK:
-                    engine.requested_direction = selected_direction;
-                    program_mode = 0;
-                default:
-                    break;
-                
-                }
-            }
-            else
-            {
-            
-                switch(key)
-                {
-                case KEY_UP:
-                    if(cur_id < prog_mode_max-1)
-                        cur_id++;
-                    else
-                        cur_id = 0;
-                    break;
-
-                case KEY_DOWN:
-                    if(cur_id > 0)
-                        cur_id--;
-                    else
-                        cur_id = prog_mode_max - 1;
-                    break;
-                        
-                case KEY_OK:
-                    program_mode = 1;
-                    break;
-
-                case KEY_ESC:
-                    mode = 0;
-                    cur_id = 0;
-                    break;
-
-                default:
-                    break;
-                        
-                }
-            }
+static void task_diag(void)
+{
+    static uint32_t last;
+    uint32_t now = tick_get();
+    uint32_t window = (now - last) * ((SysTick->LOAD + 1) / 100);
+    if(window != 0)
+    {
+        idle_percent = idle_cycles / window;
+    }
+    idle_cycles = 0;
+    last = now;
+}
 
-            break;
-        }
+static SchedTask tasks[TASK_COUNT] =
+{
+    [TASK_FAULT] = SCHED_TASK(task_fault, 1, 200),
+    [TASK_ENGINE] = SCHED_TASK(task_engine, 1, 500),   /* 1 kHz, ramp rate by ENGINE_RAMP_STEPS */
+    [TASK_KEYS] = SCHED_TASK(task_keys, 10, 5000),
+    [TASK_STORE] = SCHED_TASK(task_store, 10, 5000),  /* flash half-word per store */
+    [TASK_COMMAND] = SCHED_TASK(task_command, 5, 5000), /* before the receive ring wraps */
+    [TASK_UI] = SCHED_TASK(task_ui, 50, 50000),    /* 20 Hz, display power-up first */
+    [TASK_WATCHDOG] = SCHED_TASK(task_watchdog, 10, 1000),
+    [TASK_DIAG] = SCHED_TASK(task_diag, 1000, 50000)
+};
+
+/* Period of the 1 kHz tasks while the engine is stopped. */
+#define IDLE_PERIOD_MS 10
+
+void EXTI4_15_IRQHandler(void)
+{
+    EXTI->PR = EXTI_PR_PR10;
+    sched_wake(&tasks[TASK_FAULT]); /* fault monitor, may be slowed down */
+}
+
+/** 
+ * Helper function. Sleeps until the next task release. While the
+ * engine is stopped the 1 kHz tasks slow down and the tick is
+ * stretched to the next release or key scan. A running engine is
+ * commutated from every tick, so then it sleeps one tick at most.
+ */
+static void idle(void)
+{
+    unsigned char stopped = drives_stopped();
+    tasks[TASK_FAULT].period_ms = stopped ? IDLE_PERIOD_MS : 1;
+    tasks[TASK_ENGINE].period_ms = stopped ? IDLE_PERIOD_MS : 1;
 
+    __disable_irq();
+    int32_t ms = (int32_t)(sched_next_release() - tick_get());
+    if(ms <= 0)
+    {
+        __enable_irq();
+        return;
     }
-    
+    if(!stopped)
+    {
+        ms = 1;
+    }
+    else if(key_bus != 0 && key_bus->scan_timer < ms)
+    {
+        ms = key_bus->scan_timer;
+    }
+    idle_cycles += tick_sleep(ms);
 }
 
+extern const uint32_t _image_crc; /* linker script, after the image */
+
+/** 
+ * Helper function. Checks the firmware image against the checksum
+ * written by tools/image_crc. An image loaded from the ELF file, e.g.
+ * by the debugger, has 0 there and is not checked. An erased word, left
+ * by interrupted programming, is a mismatch like any other.
+ * 
+ * @return 1 if the image is intact or not checked
+ */
+static unsigned char image_check(void)
+{
+    if(_image_crc == 0)
+        return 1;
+    return crc32((const void*)FLASH_BASE, (uint32_t)&_image_crc - FLASH_BASE) == _image_crc;
+}
 
 int main(void)
 {
@@ -469,8 +999,12 @@ int main(void)
     RCC->AHBENR |= RCC_AHBENR_GPIOAEN;
 
   
-    GPIOA->MODER &= ~(1 << (10*2)); /* set PA10 as input. */
-    GPIOA->PUPDR |= GPIO_PUPDR_PUPDR10_0;
+    /* Fault input also wakes the CPU up. */
+    RCC->APB2ENR |= RCC_APB2ENR_SYSCFGEN;
+    SYSCFG->EXTICR[2] = (SYSCFG->EXTICR[2] & ~SYSCFG_EXTICR3_EXTI10) | SYSCFG_EXTICR3_EXTI10_PA;
+    EXTI->RTSR |= EXTI_RTSR_TR10;
+    EXTI->IMR |= EXTI_IMR_MR10;
+    NVIC_EnableIRQ(EXTI4_15_IRQn);
 
    
 
@@ -478,140 +1012,62 @@ int main(void)
     SysTick_Config(SystemCoreClock / 1000);
     
     PT6961_Init pt;
+    PT6961_Init* chips[] = {&pt};
+    PT6961_Bus bus;
     pt.CLK = gpiopin(GPIOB, 5);
     pt.DIN = gpiopin(GPIOB, 7);
     pt.DOUT = gpiopin(GPIOB, 6);
     pt.STB = gpiopin(GPIOB, 4);
-    snprintf(pt.value, PT_LEN+1, "BLDC00");
+    snprintf(pt.value, PT_VALUE_LEN+1, "BLDC00");
     pt.handler = 0; //key_handler;
     
-    engine_init_pins();
-    pt6961_init(&pt);
-    pt6961_update(&pt);
-    DelayMs(10);
+    params_init();
+    selected_rotation = rotation_limit(params_get(PARAM_SELECTED_ROTATION));
+    selected_direction = params_get(PARAM_SELECTED_DIRECTION) != 0;
+    unsigned char i;
+    for(i = 0; i < ENGINE_COUNT; i++)
+    {
+        engine_init(&drives[i], &engine_pins[i]);
+        /* Setpoint of the last run, the engine still waits for START. */
+        drives[i].requested_direction = params_get(PARAM_REQUESTED_DIRECTION) != 0;
+        drives[i].requested_rotation = rotation_limit(params_get(PARAM_REQUESTED_ROTATION));
+    }
+    events_init();
+    events_log(EVENT_RESET, watchdog_reset_flags(), 0);
+    if(!image_check())
+    {
+        image_bad = 1;
+        events_log(EVENT_IMAGE_CRC, 0, 0);
+    }
+    menu_init(&menu, menu_groups, sizeof(menu_groups) / sizeof(menu_groups[0]));
+    pt6961_bus_init(&bus, chips, sizeof(chips) / sizeof(chips[0]));
+    CORO_INIT(&pt.start);
+    display_pending = &pt; /* powered up by task_ui */
+    ambient_init();
+
+    serial_init(SERIAL_BAUD);
+    int32_t address = params_get(PARAM_ADDRESS);
+    if(address < 1 || address > ADDRESS_MAX)
+        address = 1;
+#if PROTOCOL_MODBUS
+    rtu_init(SERIAL_BAUD);
+    modbus_init(&modbus, holding_registers, sizeof(holding_registers) / sizeof(holding_registers[0]),
+                input_registers, sizeof(input_registers) / sizeof(input_registers[0]), address);
+    sched_init(tasks, TASK_COUNT);
+#else
+    command_init(&command_port, commands, sizeof(commands) / sizeof(commands[0]),
+                 address, serial_ready, serial_send);
+    sched_init(tasks, TASK_COUNT);
+#endif
+    watchdog_init();
 
     /* Main program loop */
 	while (1)
 	{
-        /* snprintf(pt.value, PT_LEN+1, "1F%d", engine.requested_rotation); */
-        /* pt6961_update(&pt); */
-        /* if(!gpio_get(GPIOA, 10)) */
-        /*     engine.fault_overcurrent = 1; */
-        if(gpio_get(GPIOA, 10))
+        if(!sched_poll())
         {
-            engine.fault_overcurrent = 1;
-            engine.state = 3;
+            idle();
         }
-        
-        uint32_t data = key_handler(&pt, 0);
-        uint32_t inert_counter = 0;
-        static uint32_t rotation_before_reverse;
-        static unsigned char first_detected_reverse = 0;
-        handle_menu(&pt, data);
-        /* Control the engine state: */
-        switch(engine.state)
-        {    
-        case 0: /* init engine */
-            engine.phase = 0;
-            engine.direction = 0;
-            engine.rotation = 0;
-            engine.requested_direction = 0;
-            engine.requested_rotation = 0;
-            engine.started = 0;
-            engine.fault_overcurrent = 0;
-            engine.state = 1;
-            break;
-        case 1: /* engine ready */
-            if(engine.requested_direction !=  engine.direction)
-            {
-                if(!first_detected_reverse)
-                {
-                    rotation_before_reverse = engine.requested_rotation;
-                    first_detected_reverse = 1;
-                }
-                engine.state = 4;
-                break;
-            }
-            if(engine.requested_rotation > 0 && engine.started == 1 && engine.fault_overcurrent == 0)
-            {
-                engine.duration = 60000 / (engine.rotation * PHASES);
-                engine_set_phase_delay(engine.duration);
-                engine.state = 2;
-            }
-            else
-            {
-                engine.rotation = 0;
-            }
-            break;
-
-        case 2: /* engine rotating */
-            if(engine.started == 0 || engine.fault_overcurrent == 1)
-            {
-                /* engine.requested_rotation = 0; */
-                engine.rotation = 0;
-            }
-            if(inert_counter == 0)
-            {
-                if(engine.rotation < engine.requested_rotation)
-                {
-                    engine.rotation++;
-                    engine.state = 1;
-                }
-                if(engine.rotation > engine.requested_rotation)
-                {
-                    engine.rotation--;
-                    engine.state = 1;
-                }
-                if(engine.rotation != engine.requested_rotation && engine.rotation % 10 == 0)
-                    engine.state = 1;
-                inert_counter = 0;
-            }
-            else
-            {
-                inert_counter--;
-            }
-            if(engine.requested_direction !=  engine.direction)
-            {
-                if(!first_detected_reverse)
-                {
-                    rotation_before_reverse = engine.requested_rotation;
-                    first_detected_reverse = 1;
-                }
-                engine.state = 4;
-                break;
-            }
-            break;
-
-        case 3: /* engine stopped */
-            engine.started = 0;
-            engine.requested_rotation = 0;
-            engine.rotation = 0;
-            engine.state = 1;
-            break;
-        case 4: /* engine needs to be reversed */
-            if(engine.rotation > 0)
-            {
-                engine.requested_rotation = 0;
-                engine.state = 2;
-            }
-            else
-            {
-                engine.direction = engine.requested_direction;
-                engine.requested_rotation = rotation_before_reverse;
-                engine.phase = 0;
-                engine.started = 1;
-                first_detected_reverse = 0;
-                engine.state = 2;
-            }
-            break;
-
-        default:
-            break;
-            
-        }
-
-        /* Change output pins configuration */
-        engine_set_pins_to_phase(engine.phase);
 	}
 	
 	return 0;
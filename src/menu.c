@@ -0,0 +1,173 @@
+/**
+ * @file   menu.c
+ * @author Wiktor Gołgowski <wgolgowski@gmail.com>
+ * @date   Mon Oct 19 16:02:41 2026
+ *
+ * @brief  Table-driven menu engine implementation.
+ *
+ */
+
+#include <mini-printf.h>
+#include "menu.h"
+
+/* Flags describing visible state, besides group, page and value. */
+#define SHOWN_EDITING 0x01
+#define SHOWN_ALERT 0x02
+
+void menu_init(Menu* menu, const MenuGroup* groups, unsigned char group_count)
+{
+    menu->groups = groups;
+    menu->group_count = group_count;
+    menu->group = 0;
+    menu->page = 0;
+    menu->editing = 0;
+    menu->alert = 0;
+    menu->edit_value = 0;
+    menu->shown = 0;
+}
+
+void menu_invalidate(Menu* menu)
+{
+    menu->shown = 0;
+}
+
+unsigned char menu_key(Menu* menu, unsigned char key)
+{
+    const MenuGroup* group = &menu->groups[menu->group];
+    const MenuPage* page = &group->pages[menu->page];
+
+    if(menu->editing)
+    {
+        switch(key)
+        {
+        case KEY_UP:
+            if(page->editor == MENU_EDIT_TOGGLE)
+                menu->edit_value = !menu->edit_value;
+            else if(menu->edit_value + page->step <= page->max)
+                menu->edit_value += page->step;
+            break;
+
+        case KEY_DOWN:
+            if(page->editor == MENU_EDIT_TOGGLE)
+                menu->edit_value = !menu->edit_value;
+            else if(menu->edit_value - page->step >= page->min)
+                menu->edit_value -= page->step;
+            break;
+
+        case KEY_OK:
+            if(page->commit != 0)
+                page->commit(menu->edit_value);
+            menu->editing = 0;
+            break;
+
+        case KEY_ESC:
+            menu->editing = 0;
+            break;
+
+        default:
+            return 0;
+        }
+        return 1;
+    }
+
+    switch(key)
+    {
+    case KEY_UP:
+        if(menu->page < group->count - 1)
+            menu->page++;
+        else
+            menu->page = 0;
+        break;
+
+    case KEY_DOWN:
+        if(menu->page > 0)
+            menu->page--;
+        else
+            menu->page = group->count - 1;
+        break;
+
+    case KEY_OK:
+        if(page->editor != MENU_EDIT_NONE)
+        {
+            menu->edit_value = page->get();
+            menu->editing = 1;
+        }
+        else if(page->commit != 0)
+        {
+            page->commit(page->get());
+        }
+        break;
+
+    case KEY_ESC:
+        if(menu->group < menu->group_count - 1)
+            menu->group++;
+        else
+            menu->group = 0;
+        menu->page = 0;
+        break;
+
+    default:
+        return 0;
+    }
+    return 1;
+}
+
+void menu_render(Menu* menu, PT6961_Init* pt)
+{
+    const MenuGroup* group = &menu->groups[menu->group];
+    const MenuPage* page = &group->pages[menu->page];
+    int32_t value = menu->editing ? menu->edit_value : page->get();
+    unsigned char flags = 0;
+
+    if(menu->editing)
+        flags |= SHOWN_EDITING;
+    if(menu->alert)
+        flags |= SHOWN_ALERT;
+
+    if(menu->shown && menu->shown_group == menu->group && menu->shown_page == menu->page
+       && menu->shown_flags == flags && menu->shown_value == value)
+    {
+        return; /* nothing visible changed */
+    }
+
+    /* Mode character and page number. */
+    char prefix[4] = {' ', ' ', '\0', '\0'};
+    unsigned char label_mask = 0b011;
+    prefix[0] = menu->alert ? group->alert_label : group->label;
+    if(menu->page > 9)
+    {
+        prefix[1] = '0' + menu->page / 10;
+        prefix[2] = '0' + menu->page % 10;
+        label_mask = 0b111;
+    }
+    else
+    {
+        prefix[1] = '0' + menu->page;
+    }
+
+    switch(page->format)
+    {
+    case MENU_FMT_FIXED1:
+        pt6961_show_fixed(pt, prefix, value, 1);
+        break;
+
+    case MENU_FMT_DIRECTION:
+        snprintf((char*)pt->value, PT_VALUE_LEN+1, "%s%c", prefix, value ? 'r' : 'l');
+        pt6961_update(pt);
+        break;
+
+    case MENU_FMT_INT:
+    default:
+        pt6961_show_s32(pt, prefix, value);
+        break;
+    }
+
+    /* Label of edited page blinks. */
+    pt6961_blink(pt, menu->editing ? label_mask : 0, MENU_BLINK_MS);
+
+    menu->shown = 1;
+    menu->shown_group = menu->group;
+    menu->shown_page = menu->page;
+    menu->shown_flags = flags;
+    menu->shown_value = value;
+}
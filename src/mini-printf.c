@@ -53,55 +53,79 @@ mini_strlen(const char *s)
 	return len;
 }
 
-static unsigned int
-mini_itoa(int value, unsigned int radix, unsigned int uppercase,
-	 char *buffer, unsigned int zero_pad)
-{
-	char	*pbuffer = buffer;
-	int	negative = 0;
-	unsigned int	i, len;
+/* Cortex-M0 has no hardware divider, so every '/' or '%' becomes a
+ * libgcc __aeabi_uidivmod call. Division by ten is done here with
+ * the shift-and-add reciprocal from Hacker's Delight, which needs a
+ * single (one cycle) muls per digit. */
+static const unsigned int mini_pow10[] = {
+	1, 10, 100, 1000, 10000, 100000,
+	1000000, 10000000, 100000000, 1000000000
+};
 
-	/* No support for unusual radixes. */
-	if (radix > 16)
-		return 0;
+unsigned int
+mini_divu10(unsigned int n, unsigned int *rem)
+{
+	unsigned int q, r;
 
-	if (value < 0) {
-		negative = 1;
-		value = -value;
+	q = (n >> 1) + (n >> 2);
+	q += q >> 4;
+	q += q >> 8;
+	q += q >> 16;
+	q >>= 3;
+	r = n - q * 10;
+	if (r > 9) {
+		q++;
+		r -= 10;
 	}
+	*rem = r;
+	return q;
+}
 
-	/* This builds the string back to front ... */
-	do {
-		int digit = value % radix;
-		*(pbuffer++) = (digit < 10 ? '0' + digit : (uppercase ? 'A' : 'a') + digit - 10);
-		value /= radix;
-	} while (value > 0);
-
-	for (i = (pbuffer - buffer); i < zero_pad; i++)
-		*(pbuffer++) = '0';
+/* Number of digits needed to print value in given radix. */
+static unsigned int
+mini_ndigits(unsigned int value, unsigned int radix)
+{
+	unsigned int len = 1;
 
-	if (negative)
-		*(pbuffer++) = '-';
+	if (radix == 16) {
+		while (len < 8 && (value >> (len * 4)) != 0)
+			len++;
+	}
+	else {
+		while (len < 10 && value >= mini_pow10[len])
+			len++;
+	}
+	return len;
+}
 
-	*(pbuffer) = '\0';
+/* Stores exactly len digits of value, ending just before end. If
+ * point is non-zero, a '.' is inserted point digits from the right.
+ * Each digit goes straight into its final place, so there is no
+ * reverse pass and no intermediate buffer. */
+static void
+mini_itoa(unsigned int value, unsigned int radix, unsigned int uppercase,
+	 char *end, unsigned int len, unsigned int point)
+{
+	unsigned int digit;
 
-	/* ... now we reverse it (could do it recursively but will
-	 * conserve the stack space) */
-	len = (pbuffer - buffer);
-	for (i = 0; i < len / 2; i++) {
-		char j = buffer[i];
-		buffer[i] = buffer[len-i-1];
-		buffer[len-i-1] = j;
+	while (len--) {
+		if (radix == 16) {
+			digit = value & 0x0F;
+			value >>= 4;
+		}
+		else {
+			value = mini_divu10(value, &digit);
+		}
+		*(--end) = (digit < 10 ? '0' + digit : (uppercase ? 'A' : 'a') + digit - 10);
+		if (point != 0 && --point == 0)
+			*(--end) = '.';
 	}
-
-	return len;
 }
 
 int
 mini_vsnprintf(char *buffer, unsigned int buffer_len, char *fmt, va_list va)
 {
 	char *pbuffer = buffer;
-	char bf[24];
 	char ch;
 
 	int _putc(char ch)
@@ -128,6 +152,12 @@ mini_vsnprintf(char *buffer, unsigned int buffer_len, char *fmt, va_list va)
 		return len;
 	}
 
+	void _pad(char c, unsigned int len)
+	{
+		while (len-- && _putc(c))
+			;
+	}
+
 	while ((ch=*(fmt++))) {
 		if ((unsigned int)((pbuffer - buffer) + 1) >= buffer_len)
 			break;
@@ -135,19 +165,38 @@ mini_vsnprintf(char *buffer, unsigned int buffer_len, char *fmt, va_list va)
 			_putc(ch);
 		else {
 			char zero_pad = 0;
+			char left = 0;
+			unsigned int width = 0;
+			unsigned int prec = 1;
 			char *ptr;
 			unsigned int len;
 
 			ch=*(fmt++);
 
-			/* Zero padding requested */
-			if (ch=='0') {
+			/* Flags: left alignment, zero padding */
+			for (;; ch=*(fmt++)) {
+				if (ch == '-')
+					left = 1;
+				else if (ch == '0')
+					zero_pad = 1;
+				else
+					break;
+			}
+
+			/* Field width */
+			while (ch >= '0' && ch <= '9') {
+				width = width * 10 + (ch - '0');
 				ch=*(fmt++);
-				if (ch == '\0')
-					goto end;
-				if (ch >= '0' && ch <= '9')
-					zero_pad = ch - '0';
+			}
+
+			/* Precision, decimal places for %q */
+			if (ch == '.') {
+				prec = 0;
 				ch=*(fmt++);
+				while (ch >= '0' && ch <= '9') {
+					prec = prec * 10 + (ch - '0');
+					ch=*(fmt++);
+				}
 			}
 
 			switch (ch) {
@@ -156,23 +205,64 @@ mini_vsnprintf(char *buffer, unsigned int buffer_len, char *fmt, va_list va)
 
 				case 'u':
 				case 'd':
-					len = mini_itoa(va_arg(va, unsigned int), 10, 0, bf, zero_pad);
-					_puts(bf, len);
-					break;
-
+				case 'q':
 				case 'x':
-				case 'X':
-					len = mini_itoa(va_arg(va, unsigned int), 16, (ch=='X'), bf, zero_pad);
-					_puts(bf, len);
+				case 'X': {
+					unsigned int value = va_arg(va, unsigned int);
+					unsigned int radix = (ch == 'x' || ch == 'X') ? 16 : 10;
+					unsigned int point = (ch == 'q') ? prec : 0;
+					unsigned int negative = 0;
+					unsigned int digits, room;
+
+					if ((ch == 'd' || ch == 'q') && (int)value < 0) {
+						negative = 1;
+						value = -value;
+					}
+
+					digits = mini_ndigits(value, radix);
+					if (point != 0 && digits <= point)
+						digits = point + 1; /* leading "0." */
+					len = negative + digits + (point != 0);
+					if (zero_pad && !left && width > len) {
+						digits += width - len;
+						len = width;
+					}
+
+					/* A cut number reads as a wrong value, mark overflow instead. */
+					room = buffer_len - (pbuffer - buffer) - 1;
+					if ((width > len ? width : len) > room) {
+						_pad('-', room);
+						break;
+					}
+
+					if (!left && width > len)
+						_pad(' ', width - len);
+					if (negative)
+						_putc('-');
+					pbuffer += digits + (point != 0);
+					*(pbuffer) = '\0';
+					mini_itoa(value, radix, (ch=='X'), pbuffer, digits, point);
+					if (left && width > len)
+						_pad(' ', width - len);
 					break;
+				}
 
 				case 'c' :
+					if (!left && width > 1)
+						_pad(' ', width - 1);
 					_putc((char)(va_arg(va, int)));
+					if (left && width > 1)
+						_pad(' ', width - 1);
 					break;
 
 				case 's' :
 					ptr = va_arg(va, char*);
-					_puts(ptr, mini_strlen(ptr));
+					len = mini_strlen(ptr);
+					if (!left && width > len)
+						_pad(' ', width - len);
+					_puts(ptr, len);
+					if (left && width > len)
+						_pad(' ', width - len);
 					break;
 
 				default:
@@ -0,0 +1,201 @@
+/**
+ * @file   modbus.c
+ * @author Wiktor Gołgowski <wgolgowski@gmail.com>
+ * @date   Wed Oct 21 15:40:27 2026
+ * 
+ * @brief  Modbus RTU slave.
+ * 
+ */
+
+#include "modbus.h"
+
+/* Function codes. */
+#define READ_HOLDING 0x03
+#define READ_INPUT 0x04
+#define WRITE_SINGLE 0x06
+#define WRITE_MULTIPLE 0x10
+
+/* Register counts that fit a frame of MODBUS_ADU_MAX bytes: address,
+ * function, count and CRC, plus address and count to write. */
+#define READ_MAX ((MODBUS_ADU_MAX - 5) / 2)
+#define WRITE_MAX ((MODBUS_ADU_MAX - 9) / 2)
+
+/// Reflected CRC of one nibble, like crc16.c.
+static const uint16_t crc_nibble[16] =
+{
+    0x0000, 0xCC01, 0xD801, 0x1400, 0xF001, 0x3C00, 0x2800, 0xE401,
+    0xA001, 0x6C00, 0x7800, 0xB401, 0x5000, 0x9C01, 0x8801, 0x4400
+};
+
+void modbus_init(ModbusSlave* slave, const ModbusRegister* holding, uint16_t holding_count,
+                 const ModbusRegister* input, uint16_t input_count, unsigned char address)
+{
+    slave->holding = holding;
+    slave->holding_count = holding_count;
+    slave->input = input;
+    slave->input_count = input_count;
+    slave->address = address;
+    slave->errors = 0;
+}
+
+uint16_t modbus_crc(const unsigned char* data, uint16_t len)
+{
+    uint16_t crc = 0xFFFF;
+    while(len-- != 0)
+    {
+        unsigned char b = *data++;
+        crc = (crc >> 4) ^ crc_nibble[(crc ^ b) & 0x0F];
+        crc = (crc >> 4) ^ crc_nibble[(crc ^ (b >> 4)) & 0x0F];
+    }
+    return crc;
+}
+
+static uint16_t get16(const unsigned char* p)
+{
+    return (p[0] << 8) | p[1];
+}
+
+/** 
+ * Helper function. Reads registers into a reply.
+ * 
+ * @param regs register table
+ * @param count number of registers in the table
+ * @param req request PDU, after the function code
+ * @param len number of request PDU bytes
+ * @param out reply PDU, after the function code
+ * 
+ * @return number of reply bytes, or minus exception code
+ */
+static int16_t modbus_read(const ModbusRegister* regs, uint16_t count,
+                           const unsigned char* req, uint16_t len, unsigned char* out)
+{
+    if(len != 4)
+        return -MODBUS_ILLEGAL_VALUE;
+    uint16_t first = get16(req);
+    uint16_t n = get16(req + 2);
+    if(n == 0 || n > READ_MAX)
+        return -MODBUS_ILLEGAL_VALUE;
+    if(first >= count || n > count - first)
+        return -MODBUS_ILLEGAL_ADDRESS;
+
+    *out++ = 2 * n;
+    while(n-- != 0)
+    {
+        uint16_t value = regs[first++].get();
+        *out++ = value >> 8;
+        *out++ = value;
+    }
+    return 1 + 2 * get16(req + 2);
+}
+
+/** 
+ * Helper function. Writes registers from a request. Registers are
+ * written in order, so a rejected value leaves the ones before it set.
+ * 
+ * @param slave pointer to slave state
+ * @param first first register
+ * @param n number of registers
+ * @param values big-endian values
+ * 
+ * @return 0, or minus exception code
+ */
+static int16_t modbus_write(ModbusSlave* slave, uint16_t first, uint16_t n, const unsigned char* values)
+{
+    if(first >= slave->holding_count || n > slave->holding_count - first)
+        return -MODBUS_ILLEGAL_ADDRESS;
+    uint16_t i;
+    for(i = first; i < first + n; i++)
+    {
+        if(slave->holding[i].set == 0)
+            return -MODBUS_ILLEGAL_ADDRESS;
+    }
+    for(i = first; i < first + n; i++, values += 2)
+    {
+        if(!slave->holding[i].set(get16(values)))
+            return -MODBUS_ILLEGAL_VALUE;
+    }
+    return 0;
+}
+
+uint16_t modbus_frame(ModbusSlave* slave, const unsigned char* req, uint16_t len, unsigned char* reply)
+{
+    if(len < 4 || len > MODBUS_ADU_MAX
+       || modbus_crc(req, len - 2) != (req[len-2] | (req[len-1] << 8)))
+    {
+        slave->errors++;
+        return 0;
+    }
+    if(req[0] != slave->address && req[0] != 0)
+    {
+        return 0;
+    }
+
+    const unsigned char* pdu = req + 2;
+    uint16_t pdu_len = len - 4;
+    int16_t result;
+    switch(req[1])
+    {
+    case READ_HOLDING:
+        result = modbus_read(slave->holding, slave->holding_count, pdu, pdu_len, reply + 2);
+        break;
+
+    case READ_INPUT:
+        result = modbus_read(slave->input, slave->input_count, pdu, pdu_len, reply + 2);
+        break;
+
+    case WRITE_SINGLE:
+        if(pdu_len != 4)
+            result = -MODBUS_ILLEGAL_VALUE;
+        else
+            result = modbus_write(slave, get16(pdu), 1, pdu + 2);
+        if(result == 0)
+        {
+            uint16_t i;
+            for(i = 0; i < 4; i++)
+                reply[2 + i] = pdu[i]; /* echo */
+            result = 4;
+        }
+        break;
+
+    case WRITE_MULTIPLE:
+        if(pdu_len < 5 || get16(pdu + 2) == 0 || get16(pdu + 2) > WRITE_MAX
+           || pdu[4] != 2 * get16(pdu + 2) || pdu_len != 5 + pdu[4])
+            result = -MODBUS_ILLEGAL_VALUE;
+        else
+            result = modbus_write(slave, get16(pdu), get16(pdu + 2), pdu + 5);
+        if(result == 0)
+        {
+            uint16_t i;
+            for(i = 0; i < 4; i++)
+                reply[2 + i] = pdu[i]; /* address and count */
+            result = 4;
+        }
+        break;
+
+    default:
+        result = -MODBUS_ILLEGAL_FUNCTION;
+        break;
+    }
+
+    if(req[0] == 0)
+    {
+        return 0; /* broadcast */
+    }
+
+    uint16_t n = 2;
+    reply[0] = slave->address;
+    reply[1] = req[1];
+    if(result < 0)
+    {
+        reply[1] |= 0x80;
+        reply[n++] = -result;
+    }
+    else
+    {
+        n += result;
+    }
+    uint16_t crc = modbus_crc(reply, n);
+    reply[n++] = crc;
+    reply[n++] = crc >> 8;
+    return n;
+}
@@ -0,0 +1,224 @@
+/**
+ * @file   params.c
+ * @author Wiktor Gołgowski <wgolgowski@gmail.com>
+ * @date   Tue Oct 20 09:12:44 2026
+ * 
+ * @brief  Parameter store, an append-only log of records in one of two
+ * flash pages. A change appends a record {id, value low, value high,
+ * CRC}; the last valid record of a parameter wins. When the page is
+ * full, the cache is copied to the other page and its header is
+ * written last, so a reset at any time leaves one complete page.
+ * 
+ */
+
+#include "params.h"
+#include "flash.h"
+#include "crc16.h"
+
+/* Two pages, from the linker script. */
+extern uint16_t _params_start[];
+
+#define PARAMS_MAGIC 0x5041
+#define RECORD_HALVES 4
+#define PAGE_HALVES (FLASH_PAGE_SIZE / 2)
+#define PAGE_RECORDS (PAGE_HALVES / RECORD_HALVES) /* slot 0 is the header */
+
+/* Work done by params_poll. */
+enum
+{
+    PARAMS_IDLE,
+    PARAMS_COPY,   /* copying cache to the other page */
+    PARAMS_HEADER  /* header of the other page is being written */
+};
+
+static int32_t cache[PARAM_COUNT];
+static uint32_t dirty; /* changed parameters, bit per id */
+static unsigned char active; /* page with current records */
+static uint16_t next_slot; /* first free slot of active page */
+static uint16_t generation; /* of active page, newer page wins */
+static unsigned char state = PARAMS_IDLE;
+static unsigned char copy_id;
+static uint16_t copy_slot;
+
+/* Record or header being programmed, one half-word per poll. */
+static uint16_t wr_buf[RECORD_HALVES];
+static uint16_t* wr_dst;
+static unsigned char wr_pos = RECORD_HALVES;
+
+/** 
+ * Helper function. Computes CRC-16/CCITT of half-words, high byte
+ * first.
+ * 
+ * @param data half-words
+ * @param halves number of half-words
+ * 
+ * @return CRC
+ */
+static uint16_t params_crc(const uint16_t* data, unsigned char halves)
+{
+    uint16_t crc = CRC16_INIT;
+    while(halves-- != 0)
+    {
+        unsigned char b[2] = {*data >> 8, *data};
+        crc = crc16(crc, b, 2);
+        data++;
+    }
+    return crc;
+}
+
+/** 
+ * Helper function. Returns a slot of a page.
+ * 
+ * @param page page number, 0 or 1
+ * @param slot slot number, 0 is the header
+ * 
+ * @return address of the slot
+ */
+static uint16_t* params_slot(unsigned char page, uint16_t slot)
+{
+    return _params_start + page * PAGE_HALVES + slot * RECORD_HALVES;
+}
+
+/** 
+ * Helper function. Checks the page header.
+ * 
+ * @param page page number
+ * 
+ * @return 1 if the page is complete
+ */
+static unsigned char params_page_valid(unsigned char page)
+{
+    uint16_t* h = params_slot(page, 0);
+    return h[3] == PARAMS_MAGIC && (uint16_t)(h[0] ^ h[1]) == 0xFFFF;
+}
+
+/** 
+ * Helper function. Prepares a record to be programmed.
+ * 
+ * @param page page number
+ * @param slot slot number
+ * @param id parameter
+ */
+static void params_record(unsigned char page, uint16_t slot, unsigned char id)
+{
+    wr_buf[0] = id; /* first, so a torn record is never free */
+    wr_buf[1] = (uint32_t)cache[id];
+    wr_buf[2] = (uint32_t)cache[id] >> 16;
+    wr_buf[3] = params_crc(wr_buf, 3);
+    wr_dst = params_slot(page, slot);
+    wr_pos = 0;
+}
+
+void params_init(void)
+{
+    unsigned char valid0 = params_page_valid(0);
+    unsigned char valid1 = params_page_valid(1);
+
+    active = 0;
+    if(valid1 && (!valid0 || (int16_t)(params_slot(1, 0)[0] - params_slot(0, 0)[0]) > 0))
+    {
+        active = 1;
+    }
+    if(!valid0 && !valid1)
+    {
+        generation = 0;
+        next_slot = PAGE_RECORDS; /* no page yet, first write rotates */
+        return;
+    }
+    generation = params_slot(active, 0)[0];
+
+    uint16_t slot;
+    for(slot = 1; slot < PAGE_RECORDS; slot++)
+    {
+        uint16_t* r = params_slot(active, slot);
+        if(r[0] == 0xFFFF)
+        {
+            break; /* free, nothing is written after it */
+        }
+        if(r[0] < PARAM_COUNT && params_crc(r, 3) == r[3])
+        {
+            cache[r[0]] = r[1] | (uint32_t)r[2] << 16;
+        }
+    }
+    next_slot = slot;
+}
+
+int32_t params_get(unsigned char id)
+{
+    return id < PARAM_COUNT ? cache[id] : 0;
+}
+
+void params_set(unsigned char id, int32_t value)
+{
+    if(id < PARAM_COUNT && cache[id] != value)
+    {
+        cache[id] = value;
+        dirty |= 1UL << id;
+    }
+}
+
+void params_poll(unsigned char quiet)
+{
+    if(wr_pos < RECORD_HALVES)
+    {
+        flash_program(wr_dst + wr_pos, wr_buf[wr_pos]);
+        wr_pos++;
+        return;
+    }
+
+    switch(state)
+    {
+    case PARAMS_COPY:
+        if(copy_id < PARAM_COUNT)
+        {
+            params_record(active ^ 1, copy_slot++, copy_id++);
+        }
+        else
+        {
+            wr_buf[0] = generation + 1;
+            wr_buf[1] = ~(generation + 1);
+            wr_buf[2] = 0xFFFF;
+            wr_buf[3] = PARAMS_MAGIC; /* last, validates the page */
+            wr_dst = params_slot(active ^ 1, 0);
+            wr_pos = 0;
+            state = PARAMS_HEADER;
+        }
+        return;
+
+    case PARAMS_HEADER:
+        active ^= 1;
+        generation++;
+        next_slot = copy_slot;
+        state = PARAMS_IDLE;
+        return;
+
+    default:
+        break;
+    }
+
+    if(dirty == 0)
+    {
+        return;
+    }
+    if(next_slot >= PAGE_RECORDS)
+    {
+        if(quiet)
+        {
+            /* Everything is copied, later changes are appended. */
+            flash_erase(params_slot(active ^ 1, 0));
+            dirty = 0;
+            copy_id = 0;
+            copy_slot = 1;
+            state = PARAMS_COPY;
+        }
+        return;
+    }
+
+    unsigned char id = 0;
+    while(!(dirty & (1UL << id)))
+    {
+        id++;
+    }
+    dirty &= ~(1UL << id);
+    params_record(active, next_slot++, id);
+}
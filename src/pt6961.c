@@ -10,6 +10,7 @@
 #include "stm32f0xx.h"
 #include "pt6961.h"
 #include "delay.h"
+#include <mini-printf.h>
 
 /**
  * Mapping bits to proper segments:
@@ -29,23 +30,76 @@
 #define DISP_E 0b00001000
 #define DISP_F 0b00100000
 #define DISP_G 0b01000000
+#define DISP_DP 0b10000000
+
+/// Segments for decimal digits, indexed by value.
+static const unsigned char digit2segment[10] =
+{
+    DISP_A | DISP_B | DISP_C | DISP_D | DISP_E | DISP_F,
+    DISP_B | DISP_C,
+    DISP_A | DISP_B | DISP_G | DISP_E | DISP_D,
+    DISP_A | DISP_B | DISP_C | DISP_D | DISP_G,
+    DISP_F | DISP_G | DISP_B | DISP_C,
+    DISP_A | DISP_F | DISP_G | DISP_C | DISP_D,
+    DISP_A | DISP_F | DISP_E | DISP_D | DISP_C | DISP_G,
+    DISP_A | DISP_B | DISP_C,
+    DISP_A | DISP_B | DISP_C | DISP_D | DISP_E | DISP_F | DISP_G,
+    DISP_A | DISP_B | DISP_C | DISP_D | DISP_F | DISP_G
+};
+
+/**
+ * Bus timing from the PT6961 datasheet, in nanoseconds. Clock is at
+ * most 1 MHz, so its half period is longer than the 400 ns minimal
+ * pulse width. Data setup and hold (100 ns) fit inside clock phases.
+ */
+#define PT_T_CLK_NS 500   /* CLK low and high time */
+#define PT_T_STB_NS 1000  /* STB pulse width, last CLK to STB rise */
+#define PT_T_WAIT_NS 1000 /* key read command to first read clock */
+
+/* Cycles of one pt6961_bus_wait loop iteration (subs + taken bne). */
+#define PT_LOOP_CYCLES 4
+
+/* Bus timing in pt6961_bus_wait loops, computed by pt6961_timing. */
+static uint32_t t_clk = 1;
+static uint32_t t_stb = 1;
+static uint32_t t_wait = 1;
+
+/** 
+ * Helper function. Converts time to pt6961_bus_wait loops at current core
+ * clock, rounding up. Never returns zero.
+ * 
+ * @param ns time in nanoseconds
+ * @param mhz core clock in MHz
+ * 
+ * @return number of loops
+ */
+static uint32_t pt6961_loops(uint32_t ns, uint32_t mhz)
+{
+    uint32_t cycles = (ns * mhz + 999) / 1000;
+    uint32_t loops = (cycles + PT_LOOP_CYCLES - 1) / PT_LOOP_CYCLES;
+    return loops ? loops : 1;
+}
 
 /** 
- * Helper function. As DelayMs has resolution on 1ms, here is
- * something faster.
+ * Helper function. Busy waits given number of loops. Loop is written
+ * in assembly, so its length does not depend on optimisation level.
+ * Flash wait states only make it longer.
  * 
- * @param a iterations to make
+ * @param loops number of loops, at least one
  */
-void delay (int a)
+static inline void pt6961_bus_wait(uint32_t loops)
 {
-	volatile int i,j;
-	
-	for (i=0 ; i < a ; i++)
-	{ 
-		j++;
-	}
-	
-	return;
+    __asm__ volatile("1: subs %0, %0, #1 \n"
+                     "   bne 1b \n"
+                     : "+l" (loops) : : "cc");
+}
+
+void pt6961_timing(void)
+{
+    uint32_t mhz = (SystemCoreClock + 999999) / 1000000;
+    t_clk = pt6961_loops(PT_T_CLK_NS, mhz);
+    t_stb = pt6961_loops(PT_T_STB_NS, mhz);
+    t_wait = pt6961_loops(PT_T_WAIT_NS, mhz);
 }
 
 /** 
@@ -60,38 +114,12 @@ void delay (int a)
 unsigned char char2segment(unsigned char c)
 {
     unsigned char data = 0;
+    if(c >= '0' && c <= '9')
+    {
+        return digit2segment[c - '0'];
+    }
     switch(c)
     {
-    case '0':
-        data = DISP_A | DISP_B | DISP_C | DISP_D | DISP_E | DISP_F;
-        break;
-    case '1':
-        data = DISP_B | DISP_C;
-        break;
-    case '2':
-        data = DISP_A | DISP_B | DISP_G | DISP_E | DISP_D;
-        break;
-    case '3':
-        data = DISP_A | DISP_B | DISP_C | DISP_D | DISP_G;
-        break;
-    case '4':
-        data = DISP_F|DISP_G|DISP_B|DISP_C;
-        break;
-    case '5':
-        data = DISP_A|DISP_F|DISP_G|DISP_C|DISP_D;
-        break;
-    case '6':
-        data = DISP_A|DISP_F|DISP_E|DISP_D|DISP_C|DISP_G;
-        break;
-    case '7':
-        data = DISP_A|DISP_B|DISP_C;
-        break;
-    case '8':
-        data = DISP_A|DISP_B|DISP_C|DISP_D|DISP_E|DISP_F|DISP_G;
-        break;
-    case '9':
-        data = DISP_A|DISP_B|DISP_C|DISP_D|DISP_F|DISP_G;
-        break;
     case '-':
         data = DISP_G;
         break;
@@ -153,9 +181,45 @@ unsigned char char2segment(unsigned char c)
     case 'L':
         data = DISP_E | DISP_F | DISP_D;
         break;
+
+    case 'H':
+    case 'h':
+        data = DISP_F | DISP_E | DISP_G | DISP_B | DISP_C;
+        break;
+
+    case 'N':
+    case 'n':
+        data = DISP_E | DISP_G | DISP_C;
+        break;
+
+    case 'T':
+    case 't':
+        data = DISP_F | DISP_E | DISP_G | DISP_D;
+        break;
+
+    case 'U':
+    case 'u':
+    case 'V':
+    case 'v':
+        data = DISP_E | DISP_D | DISP_C;
+        break;
+
+    case 'Y':
+    case 'y':
+        data = DISP_F | DISP_G | DISP_B | DISP_C | DISP_D;
+        break;
+
+    case 'J':
+    case 'j':
+        data = DISP_B | DISP_C | DISP_D | DISP_E;
+        break;
+
+    case '_':
+        data = DISP_D;
+        break;
     case '.':
     case ',':
-        data = DISP_E;
+        data = DISP_DP;
         break;
     case ' ':
     default:
@@ -164,6 +228,47 @@ unsigned char char2segment(unsigned char c)
     return data;
 }
 
+/** 
+ * Helper function. Takes the bus and starts a transfer (STB low). On
+ * a shared bus it fails if a transfer to another chip is in progress,
+ * which only an interrupt can see.
+ * 
+ * @param pt pointer to PT6961 configuration structure
+ * 
+ * @return 1 if the transfer was started, 0 if the bus is busy
+ */
+static unsigned char pt6961_begin(PT6961_Init* pt)
+{
+    if(pt->bus != 0)
+    {
+        if(pt->bus->busy)
+        {
+            return 0;
+        }
+        pt->bus->busy = 1;
+    }
+    gpiopin_clear(pt->STB);
+    pt6961_bus_wait(t_clk);
+    return 1;
+}
+
+/** 
+ * Helper function. Ends a transfer (STB high) and releases the bus.
+ * 
+ * @param pt pointer to PT6961 configuration structure
+ */
+static void pt6961_end(PT6961_Init* pt)
+{
+    pt6961_bus_wait(t_stb);
+    gpiopin_set(pt->STB);
+    /* Minimal STB high time, before next transfer can begin. */
+    pt6961_bus_wait(t_stb);
+    if(pt->bus != 0)
+    {
+        pt->bus->busy = 0;
+    }
+}
+
 void pt6961_send(PT6961_Init* pt, unsigned char data)
 {
     unsigned char i;
@@ -178,14 +283,41 @@ void pt6961_send(PT6961_Init* pt, unsigned char data)
             gpiopin_clear(pt->DIN);
         }
         data >>=0x01;
-        /* blink clock */
+        /* clock pulse, data is latched on rising edge */
         gpiopin_clear(pt->CLK);
+        pt6961_bus_wait(t_clk);
         gpiopin_set(pt->CLK);
+        pt6961_bus_wait(t_clk);
     }
 }
 
-void pt6961_init(PT6961_Init* pt)
+/** 
+ * Helper function. Sends display control command: display on or off
+ * (also off in blank phase of whole display blinking) and brightness.
+ * 
+ * @param pt pointer to PT6961 configuration structure
+ */
+static void pt6961_control(PT6961_Init* pt)
+{
+    unsigned char cmd = 0b10000000 | pt->brightness;
+    if(pt->display_on && !(pt->blank && pt->blink_mask == PT_ALL_DIGITS))
+    {
+        cmd |= 0b00001000; // display on
+    }
+    if(!pt6961_begin(pt))
+    {
+        return;
+    }
+    pt6961_send(pt, cmd);
+    pt6961_end(pt);
+}
+
+unsigned char pt6961_start(PT6961_Init* pt)
 {
+    unsigned char i;
+
+    CORO_BEGIN(&pt->start);
+
     /* Setting output mode for STB, CLK and DIN */
 
     pt->CLK.port->MODER |= 1 << (pt->CLK.pin * 2);
@@ -199,87 +331,435 @@ void pt6961_init(PT6961_Init* pt)
     gpiopin_set(pt->CLK);
     gpiopin_set(pt->STB);
 
-    DelayMs(30);
+    pt6961_timing();
+    CORO_WAIT_MS(&pt->start, 30); /* chip power-up */
 
-    gpiopin_clear(pt->STB);
+    CORO_WAIT_UNTIL(&pt->start, pt6961_begin(pt));
     pt6961_send(pt, 0b01000000);
-    gpiopin_set(pt->STB);
+    pt6961_end(pt);
 
-    gpiopin_clear(pt->STB);
+    CORO_WAIT_UNTIL(&pt->start, pt6961_begin(pt));
     pt6961_send(pt, 0b11000000);
 
-    unsigned char i;
     for(i=0; i<13; i++)
     {
         pt6961_send(pt, 0x0);
     }
-    gpiopin_set(pt->STB);
+    pt6961_end(pt);
 
-    gpiopin_clear(pt->STB);
+    CORO_WAIT_UNTIL(&pt->start, pt6961_begin(pt));
     pt6961_send(pt, 0b00000010);
-    gpiopin_set(pt->STB);
+    pt6961_end(pt);
 
-    gpiopin_clear(pt->STB);
-    pt6961_send(pt, 0b10001100);
-    gpiopin_set(pt->STB);
+    pt->dirty = 0;
+    pt->key = 0;
+    for(i=0; i<PT_LEN; i++)
+    {
+        pt->ind[i] = 0x00;
+    }
+    pt->display_on = 1;
+    pt->brightness = 4;
+    pt->fade_target = 4;
+    pt->fade_ms = 0;
+    pt->blink_mask = 0;
+    pt->blank = 0;
+    pt6961_control(pt);
+
+    CORO_END(&pt->start);
 }
 
-void pt6961_print(PT6961_Init* pt, const char* str)
+void pt6961_init(PT6961_Init* pt)
 {
-    gpiopin_clear(pt->STB);
-    
-    pt6961_send(pt, 0b01000000); // select write mode.
-    pt6961_send(pt, 0b11000000); // set address to the beginning.
-    
-    unsigned char i;
-    for(i=0; i<PT_LEN; i++)
+    CORO_INIT(&pt->start);
+    while(pt6961_start(pt) != CORO_DONE)
     {
-        if(str[i] == '\0')
+        __WFI(); /* woken up by SysTick */
+    }
+}
+
+unsigned char pt6961_convert(unsigned char* seg, unsigned char len, const char* str)
+{
+    unsigned char i = 0;
+    for(; *str != '\0'; str++)
+    {
+        if((*str == '.' || *str == ',') && i > 0 && (seg[i-1] & DISP_DP) == 0)
+        {
+            seg[i-1] |= DISP_DP;
+        }
+        else if(i < len)
+        {
+            seg[i++] = char2segment(*str);
+        }
+        else
+        {
             break;
-        pt6961_send(pt, char2segment(str[i]));
-        pt6961_send(pt, 0xFF); // there are more segments available, so we omit the second byte.
+        }
     }
+    return i;
+}
+
+/** 
+ * Helper function. Converts a string into segment bytes for the
+ * whole display, blanking unused positions.
+ * 
+ * @param seg output, PT_LEN segment bytes
+ * @param str string to convert
+ */
+static void str2segment(unsigned char* seg, const unsigned char* str)
+{
+    unsigned char i = pt6961_convert(seg, PT_LEN, (const char*)str);
     for(; i < PT_LEN; i++)
     {
-        pt6961_send(pt, 0x00);
-        pt6961_send(pt, 0x00);
+        seg[i] = 0x00;
     }
-    pt6961_send(pt, 0x00);
-
-    gpiopin_set(pt->STB);
 }
 
-void pt6961_update(PT6961_Init* pt)
+void pt6961_show_segments(PT6961_Init* pt, const unsigned char* seg)
 {
-    gpiopin_clear(pt->STB);
+    if(!pt6961_begin(pt))
+    {
+        return;
+    }
     pt6961_send(pt, 0b01000000); // select write mode.
     pt6961_send(pt, 0b11000000); // set address to the beginning.
     
+    unsigned char mask = 0;
+    if(pt->blank && pt->blink_mask != PT_ALL_DIGITS)
+    {
+        mask = pt->blink_mask;
+    }
+
     unsigned char i;
     for(i=0; i<PT_LEN; i++)
     {
-        if(pt->value[i] == '\0')
+        pt6961_send(pt, (mask & (1 << i)) ? 0x00 : seg[i]);
+        pt6961_send(pt, pt->ind[i]);
+    }
+    pt6961_send(pt, 0x00);
+
+    pt6961_end(pt);
+}
+
+void pt6961_print(PT6961_Init* pt, const char* str)
+{
+    unsigned char seg[PT_LEN];
+    str2segment(seg, (const unsigned char*)str);
+    pt6961_show_segments(pt, seg);
+}
+
+void pt6961_refresh(PT6961_Init* pt)
+{
+    if(pt->bus != 0)
+    {
+        pt->dirty |= PT_DIRTY_SEG; /* sent by pt6961_bus_flush */
+        return;
+    }
+    pt6961_show_segments(pt, pt->seg);
+}
+
+/** 
+ * Helper function. Sends only the indicator bytes, using fixed
+ * address mode, so digits keep whatever they show.
+ * 
+ * @param pt pointer to PT6961 configuration structure
+ */
+static void pt6961_send_indicators(PT6961_Init* pt)
+{
+    if(!pt6961_begin(pt))
+    {
+        return;
+    }
+    pt6961_send(pt, 0b01000100); // select write mode, fixed address.
+    pt6961_end(pt);
+
+    unsigned char i;
+    for(i=0; i<PT_LEN; i++)
+    {
+        if(!pt6961_begin(pt))
+        {
+            return;
+        }
+        pt6961_send(pt, 0b11000000 | (2*i + 1)); // second byte of the digit.
+        pt6961_send(pt, pt->ind[i]);
+        pt6961_end(pt);
+    }
+}
+
+void pt6961_indicator(PT6961_Init* pt, unsigned char led, unsigned char on)
+{
+    unsigned char grid = led >> 3;
+    unsigned char bit = 1 << (led & 0x07);
+    if(grid >= PT_LEN)
+    {
+        return;
+    }
+
+    unsigned char ind = on ? (pt->ind[grid] | bit) : (pt->ind[grid] & ~bit);
+    if(ind == pt->ind[grid])
+    {
+        return;
+    }
+    pt->ind[grid] = ind;
+
+    if(pt->bus != 0)
+    {
+        pt->dirty |= PT_DIRTY_IND; /* sent by pt6961_bus_flush */
+        return;
+    }
+    pt6961_send_indicators(pt);
+}
+
+void pt6961_update(PT6961_Init* pt)
+{
+    str2segment(pt->seg, pt->value);
+    pt6961_refresh(pt);
+}
+
+void pt6961_show_fixed(PT6961_Init* pt, const char* prefix, int32_t value, unsigned char decimals)
+{
+    uint32_t v = value;
+    unsigned char negative = 0;
+    unsigned char first = 0; /* first position of the number field */
+    unsigned char pos = PT_LEN;
+    unsigned char count = 0; /* digits stored so far */
+    unsigned int digit;
+
+    if(value < 0)
+    {
+        negative = 1;
+        v = -value;
+    }
+
+    while(prefix != 0 && prefix[first] != '\0' && first < PT_LEN)
+    {
+        pt->seg[first] = char2segment(prefix[first]);
+        first++;
+    }
+
+    /* Digits from the right, at least one before the point. */
+    while(pos > first)
+    {
+        v = mini_divu10(v, &digit);
+        pt->seg[--pos] = digit2segment[digit];
+        count++;
+        if(decimals != 0 && count == decimals + 1)
+        {
+            pt->seg[pos] |= DISP_DP;
+        }
+        if(v == 0 && count > decimals)
+        {
             break;
-        pt6961_send(pt, char2segment(pt->value[i]));
-        pt6961_send(pt, 0xFF); // there are more segments available, so we omit the second byte.
+        }
     }
-    for(; i < PT_LEN; i++)
+
+    if(negative && pos > first)
     {
-        pt6961_send(pt, 0x00);
-        pt6961_send(pt, 0x00);
+        pt->seg[--pos] = DISP_G;
+        negative = 0;
     }
-    pt6961_send(pt, 0x00);
 
-    gpiopin_set(pt->STB);
+    if(v != 0 || count <= decimals || negative)
+    {
+        /* Does not fit, a cut number would read as a wrong value. */
+        pos = PT_LEN;
+        while(pos > first)
+        {
+            pt->seg[--pos] = DISP_G;
+        }
+    }
+
+    /* Leading blanking. */
+    while(pos > first)
+    {
+        pt->seg[--pos] = 0x00;
+    }
+
+    pt6961_refresh(pt);
+}
+
+void pt6961_show_s32(PT6961_Init* pt, const char* prefix, int32_t value)
+{
+    pt6961_show_fixed(pt, prefix, value, 0);
+}
+
+void pt6961_show_u32(PT6961_Init* pt, const char* prefix, uint32_t value)
+{
+    /* Values over INT32_MAX do not fit six digits anyway. */
+    pt6961_show_fixed(pt, prefix, value > 0x7FFFFFFF ? 0x7FFFFFFF : value, 0);
+}
+
+void pt6961_on(PT6961_Init* pt)
+{
+    pt->display_on = 1;
+    pt6961_control(pt);
+}
+
+void pt6961_off(PT6961_Init* pt)
+{
+    pt->display_on = 0;
+    pt6961_control(pt);
+}
+
+void pt6961_set_brightness(PT6961_Init* pt, unsigned char level)
+{
+    if(level > PT_BRIGHTNESS_MAX)
+    {
+        level = PT_BRIGHTNESS_MAX;
+    }
+    pt->brightness = level;
+    pt->fade_target = level;
+    pt6961_control(pt);
+}
+
+void pt6961_blink(PT6961_Init* pt, unsigned char mask, uint16_t period_ms)
+{
+    if(mask == pt->blink_mask && (period_ms >> 1) == pt->blink_ms)
+    {
+        return;
+    }
+
+    unsigned char was_blank = pt->blank;
+    unsigned char old_mask = pt->blink_mask;
+    pt->blink_mask = mask;
+    pt->blink_ms = period_ms >> 1;
+    pt->blank = 0;
+    pt->blink_next = tick_get() + pt->blink_ms;
+
+    if(was_blank)
+    {
+        /* Restore what the blank phase took away. */
+        if(old_mask == PT_ALL_DIGITS)
+            pt6961_control(pt);
+        else
+            pt6961_refresh(pt);
+    }
+}
+
+void pt6961_fade(PT6961_Init* pt, unsigned char level, uint16_t step_ms)
+{
+    if(level > PT_BRIGHTNESS_MAX)
+    {
+        level = PT_BRIGHTNESS_MAX;
+    }
+    pt->fade_target = level;
+    pt->fade_ms = step_ms;
+    pt->fade_next = tick_get();
+}
+
+void pt6961_effects(PT6961_Init* pt)
+{
+    uint32_t now = tick_get();
+
+    if(pt->blink_mask != 0 && (int32_t)(now - pt->blink_next) >= 0)
+    {
+        pt->blink_next += pt->blink_ms;
+        pt->blank = !pt->blank;
+        if(pt->blink_mask == PT_ALL_DIGITS)
+            pt6961_control(pt);
+        else
+            pt6961_refresh(pt);
+    }
+
+    if(pt->brightness != pt->fade_target && (int32_t)(now - pt->fade_next) >= 0)
+    {
+        if(pt->fade_ms == 0)
+            pt->brightness = pt->fade_target;
+        else if(pt->brightness < pt->fade_target)
+            pt->brightness++;
+        else
+            pt->brightness--;
+        pt->fade_next = now + pt->fade_ms;
+        pt6961_control(pt);
+    }
+}
+
+void pt6961_bus_init(PT6961_Bus* bus, PT6961_Init** chips, unsigned char count)
+{
+    unsigned char i;
+    bus->chips = chips;
+    bus->count = count;
+    bus->scan_next = 0;
+    bus->scan_timer = PT_SCAN_MS;
+    bus->busy = 0;
+    for(i = 0; i < count; i++)
+    {
+        chips[i]->bus = bus;
+    }
+}
+
+void pt6961_bus_flush(PT6961_Bus* bus)
+{
+    unsigned char i;
+    for(i = 0; i < bus->count; i++)
+    {
+        PT6961_Init* pt = bus->chips[i];
+        if(pt->dirty & PT_DIRTY_SEG)
+        {
+            /* Full write carries the indicators too. */
+            pt6961_show_segments(pt, pt->seg);
+        }
+        else if(pt->dirty & PT_DIRTY_IND)
+        {
+            pt6961_send_indicators(pt);
+        }
+        pt->dirty = 0;
+    }
+}
+
+void pt6961_bus_tick(PT6961_Bus* bus)
+{
+    if(--bus->scan_timer != 0)
+    {
+        return;
+    }
+    bus->scan_timer = PT_SCAN_MS;
+
+    if(bus->busy)
+    {
+        return; /* main loop is writing, retry with the next tick */
+    }
+
+    PT6961_Init* pt = bus->chips[bus->scan_next];
+    unsigned char key = pt6961_read(pt);
+    if(key != 0 && pt->key == 0)
+    {
+        pt->key = key;
+    }
+    if(++bus->scan_next >= bus->count)
+    {
+        bus->scan_next = 0;
+    }
+}
+
+unsigned char pt6961_bus_key(PT6961_Bus* bus, unsigned char* chip)
+{
+    unsigned char i;
+    for(i = 0; i < bus->count; i++)
+    {
+        unsigned char key = bus->chips[i]->key;
+        if(key != 0)
+        {
+            bus->chips[i]->key = 0;
+            if(chip != 0)
+            {
+                *chip = i;
+            }
+            return key;
+        }
+    }
+    return 0;
 }
 
 uint32_t pt6961_read(PT6961_Init* pt)
 {
-    gpiopin_clear(pt->STB);
+    if(!pt6961_begin(pt))
+    {
+        return 0;
+    }
     gpiopin_set(pt->CLK);
     unsigned char data = 0;
     pt6961_send(pt, 0b01000110);
-    delay(1000);
+    pt6961_bus_wait(t_wait);
     
     /* Read key matrix state. */
     data = 0;
@@ -287,12 +767,14 @@ uint32_t pt6961_read(PT6961_Init* pt)
     for(j = 0; j < 8; j++)
     {
         gpiopin_clear(pt->CLK);
+        pt6961_bus_wait(t_clk);
         //reads state of the pin.
         data = (data << 1) | ((!(pt->DOUT.port->IDR & (1 << pt->DOUT.pin))) & 0x01);
         gpiopin_set(pt->CLK);
+        pt6961_bus_wait(t_clk);
     }
     data &= ~(0b00000011);
-    gpiopin_set(pt->STB);
+    pt6961_end(pt);
     if(data == KEY_NONE || data == 0)
     {
         return 0;
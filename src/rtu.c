@@ -0,0 +1,88 @@
+/**
+ * @file   rtu.c
+ * @author Wiktor Gołgowski <wgolgowski@gmail.com>
+ * @date   Wed Oct 21 15:40:27 2026
+ * 
+ * @brief  Modbus RTU frame end detection.
+ * 
+ */
+
+#include "rtu.h"
+#include "serial.h"
+
+static __IO uint16_t idle_unread; /* unread bytes at the idle line */
+static __IO uint16_t frame_len;   /* complete frame, 0 if none */
+
+/** 
+ * Helper function. Called from the USART interrupt at an idle line,
+ * starts timing the rest of the inter-frame gap.
+ */
+static void rtu_idle(void)
+{
+    idle_unread = serial_unread();
+    TIM14->CNT = 0;
+    TIM14->CR1 |= TIM_CR1_CEN;
+}
+
+void rtu_init(uint32_t baud)
+{
+    /* 3.5 characters of 11 bits, fixed at 1750 us above 19200 bit/s.
+     * One character has passed when the idle line is reported. */
+    uint32_t gap_us = baud > 19200 ? 1750 : 38500000 / baud;
+    gap_us -= 11000000 / baud;
+
+    USART2->CR1 &= ~USART_CR1_UE;
+    USART2->CR1 |= USART_CR1_M | USART_CR1_PCE;
+    USART2->CR1 |= USART_CR1_UE;
+
+    RCC->APB1ENR |= RCC_APB1ENR_TIM14EN;
+    TIM14->PSC = SystemCoreClock / 1000000 - 1;
+    TIM14->ARR = gap_us;
+    TIM14->EGR = TIM_EGR_UG;
+    TIM14->SR = 0;
+    TIM14->DIER = TIM_DIER_UIE;
+
+    NVIC_EnableIRQ(TIM14_IRQn);
+    serial_on_idle(rtu_idle);
+}
+
+uint16_t rtu_frame(unsigned char* dst, uint16_t max)
+{
+    uint16_t len = frame_len;
+    if(len == 0)
+    {
+        return 0;
+    }
+
+    uint16_t copied = 0;
+    while(copied < len)
+    {
+        const unsigned char* data;
+        uint16_t n = serial_peek(&data);
+        if(n > len - copied)
+            n = len - copied;
+        uint16_t i;
+        for(i = 0; i < n && copied + i < max; i++)
+        {
+            dst[copied + i] = data[i];
+        }
+        serial_skip(n);
+        copied += n;
+    }
+
+    frame_len = 0;
+    return len;
+}
+
+void TIM14_IRQHandler(void)
+{
+    TIM14->SR = 0;
+    TIM14->CR1 &= ~TIM_CR1_CEN;
+
+    /* Bytes after the idle line mean the frame goes on. An unhandled
+     * frame is dropped, the master times out and retries. */
+    if(serial_unread() == idle_unread && frame_len == 0)
+    {
+        frame_len = idle_unread;
+    }
+}
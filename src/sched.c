@@ -0,0 +1,105 @@
+/**
+ * @file   sched.c
+ * @author Wiktor Gołgowski <wgolgowski@gmail.com>
+ * @date   Mon Oct 19 21:04:52 2026
+ *
+ * @brief  Cooperative scheduler implementation. Run times are measured
+ * in core clock cycles.
+ *
+ */
+
+#include "sched.h"
+
+static SchedTask* tasks;
+static unsigned char task_count;
+static uint32_t cycles_per_us;
+
+void sched_init(SchedTask* table, unsigned char count)
+{
+    tasks = table;
+    task_count = count;
+    cycles_per_us = SystemCoreClock / 1000000;
+
+    deadline_t now = tick_get();
+    unsigned char i;
+    for(i = 0; i < count; i++)
+    {
+        tasks[i].release = now;
+    }
+}
+
+unsigned char sched_poll(void)
+{
+    unsigned char i;
+    for(i = 0; i < task_count; i++)
+    {
+        SchedTask* task = &tasks[i];
+        unsigned char due = deadline_expired(task->release);
+        if(!due && !task->wake)
+        {
+            continue;
+        }
+        task->wake = 0;
+
+        /* Release time in the same cycle scale as cycle_get, woken
+         * tasks are released when they start. */
+        uint32_t released = task->release * (SysTick->LOAD + 1);
+        uint32_t start = cycle_get();
+        if(!due)
+        {
+            released = start;
+        }
+        task->run();
+        uint32_t end = cycle_get();
+
+        uint32_t spent = end - start;
+        task->runs++;
+        task->busy_cycles += spent;
+        if(spent > task->worst_cycles)
+        {
+            task->worst_cycles = spent;
+        }
+        if(end - released > task->deadline_us * cycles_per_us)
+        {
+            task->overruns++;
+        }
+
+        if(!due)
+        {
+            return 1; /* woken early, periodic releases stay */
+        }
+        task->release += task->period_ms;
+        if(deadline_expired(task->release))
+        {
+            /* Periods were missed, skip them instead of a burst. */
+            task->release = deadline_in(task->period_ms);
+        }
+        return 1;
+    }
+    return 0;
+}
+
+void sched_wake(SchedTask* task)
+{
+    task->wake = 1;
+}
+
+deadline_t sched_next_release(void)
+{
+    deadline_t now = tick_get();
+    int32_t next = INT32_MAX;
+    unsigned char i;
+    for(i = 0; i < task_count; i++)
+    {
+        if(tasks[i].wake)
+        {
+            return now;
+        }
+        int32_t wait = (int32_t)(tasks[i].release - now);
+        if(wait < next)
+        {
+            next = wait;
+        }
+    }
+    return now + next;
+}
@@ -0,0 +1,142 @@
+/**
+ * @file   scroll.c
+ * @author Wiktor Gołgowski <wgolgowski@gmail.com>
+ * @date   Mon Oct 19 18:05:44 2026
+ * 
+ * @brief  Scrolling viewport implementation.
+ * 
+ */
+
+#include "scroll.h"
+#include "delay.h"
+
+typedef struct strScrollMsg
+{
+    /* Text followed by PT_LEN blanks, so it can scroll out fully. */
+    unsigned char seg[SCROLL_MSG_LEN + PT_LEN];
+    unsigned char len; /* zero if slot is free */
+    unsigned char priority;
+    unsigned char repeat;
+    unsigned char age; /* order of posting, lower is older */
+} ScrollMsg;
+
+static ScrollMsg slots[SCROLL_SLOTS];
+static ScrollMsg* current; /* message on the display */
+static unsigned char pos; /* first position shown */
+static unsigned char posted; /* age of the next message */
+static uint16_t step_ms = SCROLL_STEP_MS;
+static uint32_t next_step;
+
+/** 
+ * Helper function. Finds the message which should own the display:
+ * highest priority, the oldest one among equal priorities.
+ * 
+ * @return message, 0 if the queue is empty
+ */
+static ScrollMsg* scroll_top(void)
+{
+    ScrollMsg* top = 0;
+    unsigned char i;
+    for(i = 0; i < SCROLL_SLOTS; i++)
+    {
+        ScrollMsg* msg = &slots[i];
+        if(msg->len == 0)
+            continue;
+        if(top == 0 || msg->priority > top->priority
+           || (msg->priority == top->priority && (unsigned char)(msg->age - top->age) > 0x7F))
+        {
+            top = msg;
+        }
+    }
+    return top;
+}
+
+unsigned char scroll_post(unsigned char priority, const char* text, unsigned char repeat)
+{
+    ScrollMsg* slot = 0;
+    unsigned char i;
+    for(i = 0; i < SCROLL_SLOTS; i++)
+    {
+        ScrollMsg* msg = &slots[i];
+        if(msg->len == 0)
+        {
+            slot = msg;
+            break;
+        }
+        /* Otherwise drop the lowest priority, oldest message. */
+        if(msg->priority < priority && (slot == 0 || msg->priority < slot->priority
+           || (msg->priority == slot->priority && (unsigned char)(msg->age - slot->age) > 0x7F)))
+        {
+            slot = msg;
+        }
+    }
+    if(slot == 0)
+    {
+        return SCROLL_NONE;
+    }
+
+    unsigned char len = pt6961_convert(slot->seg, SCROLL_MSG_LEN, text);
+    for(i = len; i < len + PT_LEN; i++)
+    {
+        slot->seg[i] = 0x00;
+    }
+    slot->len = len ? len : 1;
+    slot->priority = priority;
+    slot->repeat = repeat;
+    slot->age = posted++;
+    if(slot == current)
+    {
+        current = 0; /* slot reused, start from the beginning */
+    }
+    return slot - slots;
+}
+
+void scroll_cancel(unsigned char id)
+{
+    if(id < SCROLL_SLOTS)
+    {
+        slots[id].len = 0;
+    }
+}
+
+void scroll_set_rate(uint16_t rate)
+{
+    step_ms = rate;
+}
+
+unsigned char scroll_poll(PT6961_Init* pt)
+{
+    ScrollMsg* top = scroll_top();
+    uint32_t now = tick_get();
+
+    if(top != current)
+    {
+        /* New owner of the display, start from its beginning. */
+        current = top;
+        pos = 0;
+        next_step = now + step_ms;
+        if(current != 0)
+        {
+            pt6961_blink(pt, 0, 0);
+            pt6961_show_segments(pt, current->seg);
+        }
+    }
+    else if(current != 0 && (int32_t)(now - next_step) >= 0)
+    {
+        next_step += step_ms;
+        if(++pos > current->len)
+        {
+            /* Scrolled out, one pass done. */
+            pos = 0;
+            if(current->repeat != 0 && --current->repeat == 0)
+            {
+                current->len = 0;
+                current = 0;
+                return scroll_poll(pt);
+            }
+        }
+        pt6961_show_segments(pt, current->seg + pos);
+    }
+
+    return current != 0;
+}
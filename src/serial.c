@@ -0,0 +1,165 @@
+/**
+ * @file   serial.c
+ * @author Wiktor Gołgowski <wgolgowski@gmail.com>
+ * @date   Tue Oct 20 16:31:08 2026
+ * 
+ * @brief  Serial port with DMA transmission (DMA1 channel 4) and
+ * circular DMA reception (DMA1 channel 5). The RS-485 driver is
+ * released on the USART transmission complete flag, as DMA completes
+ * when the last byte is written to the USART, two characters early.
+ * 
+ */
+
+#include "serial.h"
+#include "gpiopin.h"
+
+static __IO unsigned char tx_busy;
+static const unsigned char* __IO queued;
+static __IO uint16_t queued_len;
+static unsigned char rx_ring[SERIAL_RX_SIZE];
+static uint16_t rx_tail; /* first unread byte */
+static void (*idle_handler)(void);
+
+/** 
+ * Helper function. Starts a DMA transfer to the transmitter.
+ * 
+ * @param data bytes to send
+ * @param len number of bytes
+ */
+static void serial_start(const unsigned char* data, uint16_t len)
+{
+    USART2->CR1 &= ~USART_CR1_TCIE; /* the driver stays enabled */
+    gpio_set(GPIOA, SERIAL_DE_PIN);
+    DMA1_Channel4->CCR &= ~DMA_CCR_EN;
+    DMA1_Channel4->CMAR = (uint32_t)data;
+    DMA1_Channel4->CNDTR = len;
+    DMA1_Channel4->CCR |= DMA_CCR_EN;
+    tx_busy = 1;
+}
+
+void serial_init(uint32_t baud)
+{
+    RCC->AHBENR |= RCC_AHBENR_GPIOAEN | RCC_AHBENR_DMA1EN;
+    RCC->APB1ENR |= RCC_APB1ENR_USART2EN;
+
+    /* PA2 and PA3 as alternate function 1 (USART2). */
+    GPIOA->AFR[0] = (GPIOA->AFR[0] & ~(GPIO_AFRL_AFRL2 | GPIO_AFRL_AFRL3)) | (1 << 8) | (1 << 12);
+    GPIOA->MODER = (GPIOA->MODER & ~(GPIO_MODER_MODER2 | GPIO_MODER_MODER3))
+        | GPIO_MODER_MODER2_1 | GPIO_MODER_MODER3_1;
+    /* RX floats while the transceiver sends, a pull-up keeps it idle. */
+    GPIOA->PUPDR = (GPIOA->PUPDR & ~GPIO_PUPDR_PUPDR3) | GPIO_PUPDR_PUPDR3_0;
+
+    /* Driver enable as output, receiving. */
+    gpio_clear(GPIOA, SERIAL_DE_PIN);
+    GPIOA->MODER = (GPIOA->MODER & ~(3 << (SERIAL_DE_PIN * 2))) | (1 << (SERIAL_DE_PIN * 2));
+
+    USART2->BRR = SystemCoreClock / baud;
+    /* Overrun detection off, a lost byte only fails the frame CRC. */
+    USART2->CR3 |= USART_CR3_DMAT | USART_CR3_DMAR | USART_CR3_OVRDIS;
+    USART2->CR1 |= USART_CR1_TE | USART_CR1_RE | USART_CR1_UE;
+
+    DMA1_Channel4->CPAR = (uint32_t)&USART2->TDR;
+    DMA1_Channel4->CCR = DMA_CCR_MINC | DMA_CCR_DIR | DMA_CCR_TCIE;
+    NVIC_EnableIRQ(DMA1_Channel4_5_IRQn);
+
+    DMA1_Channel5->CPAR = (uint32_t)&USART2->RDR;
+    DMA1_Channel5->CMAR = (uint32_t)rx_ring;
+    DMA1_Channel5->CNDTR = SERIAL_RX_SIZE;
+    DMA1_Channel5->CCR = DMA_CCR_MINC | DMA_CCR_CIRC | DMA_CCR_EN;
+
+    NVIC_EnableIRQ(USART2_IRQn);
+}
+
+void serial_on_idle(void (*handler)(void))
+{
+    idle_handler = handler;
+    USART2->ICR = USART_ICR_IDLECF;
+    if(handler != 0)
+        USART2->CR1 |= USART_CR1_IDLEIE;
+    else
+        USART2->CR1 &= ~USART_CR1_IDLEIE;
+}
+
+unsigned char serial_ready(void)
+{
+    return queued == 0;
+}
+
+unsigned char serial_send(const unsigned char* data, uint16_t len)
+{
+    unsigned char sent = 1;
+    __disable_irq();
+    if(!tx_busy)
+    {
+        serial_start(data, len);
+    }
+    else if(queued == 0)
+    {
+        queued_len = len;
+        queued = data;
+    }
+    else
+    {
+        sent = 0;
+    }
+    __enable_irq();
+    return sent;
+}
+
+uint16_t serial_peek(const unsigned char** data)
+{
+    /* Counts down to 1 and reloads, so head is always within the ring. */
+    uint16_t head = SERIAL_RX_SIZE - DMA1_Channel5->CNDTR;
+    *data = &rx_ring[rx_tail];
+    return head >= rx_tail ? head - rx_tail : SERIAL_RX_SIZE - rx_tail;
+}
+
+uint16_t serial_unread(void)
+{
+    uint16_t head = SERIAL_RX_SIZE - DMA1_Channel5->CNDTR;
+    return (head + SERIAL_RX_SIZE - rx_tail) % SERIAL_RX_SIZE;
+}
+
+void serial_skip(uint16_t len)
+{
+    rx_tail = (rx_tail + len) % SERIAL_RX_SIZE;
+}
+
+void DMA1_Channel4_5_IRQHandler(void)
+{
+    if(DMA1->ISR & DMA_ISR_TCIF4)
+    {
+        DMA1->IFCR = DMA_IFCR_CTCIF4;
+        tx_busy = 0;
+        if(queued != 0)
+        {
+            serial_start(queued, queued_len);
+            queued = 0;
+        }
+        else
+        {
+            /* Release the driver after the last stop bit. */
+            USART2->CR1 |= USART_CR1_TCIE;
+        }
+    }
+}
+
+void USART2_IRQHandler(void)
+{
+    uint32_t isr = USART2->ISR;
+
+    if((USART2->CR1 & USART_CR1_TCIE) && (isr & USART_ISR_TC))
+    {
+        USART2->CR1 &= ~USART_CR1_TCIE;
+        gpio_clear(GPIOA, SERIAL_DE_PIN);
+    }
+
+    if(isr & USART_ISR_IDLE)
+    {
+        USART2->ICR = USART_ICR_IDLECF;
+        if(idle_handler != 0)
+        {
+            idle_handler();
+        }
+    }
+}
@@ -0,0 +1,43 @@
+/**
+ * @file   telemetry.c
+ * @author Wiktor Gołgowski <wgolgowski@gmail.com>
+ * @date   Tue Oct 20 16:31:08 2026
+ * 
+ * @brief  Telemetry record packing.
+ * 
+ */
+
+#include "telemetry.h"
+
+/** 
+ * Helper function. Stores a 16-bit value, little-endian.
+ * 
+ * @param p output
+ * @param value value to store
+ * 
+ * @return position after the value
+ */
+static unsigned char* telemetry_put16(unsigned char* p, uint16_t value)
+{
+    p[0] = value;
+    p[1] = value >> 8;
+    return p + 2;
+}
+
+void telemetry_pack(unsigned char* out, const Telemetry* t)
+{
+    unsigned char* p = out;
+    p = telemetry_put16(p, t->time_ms);
+    p = telemetry_put16(p, t->time_ms >> 16);
+    *p++ = t->state;
+    *p++ = t->phase;
+    *p++ = t->flags;
+    *p++ = t->idle_percent;
+    p = telemetry_put16(p, t->requested_rpm);
+    p = telemetry_put16(p, t->rpm);
+    p = telemetry_put16(p, t->current[0]);
+    p = telemetry_put16(p, t->current[1]);
+    p = telemetry_put16(p, t->current[2]);
+    p = telemetry_put16(p, t->jitter_us);
+    telemetry_put16(p, t->overruns);
+}
@@ -0,0 +1,98 @@
+/**
+ * @file   watchdog.c
+ * @author Wiktor Gołgowski <wgolgowski@gmail.com>
+ * @date   Tue Oct 20 14:05:51 2026
+ * 
+ * @brief  Independent watchdog with client supervision. IWDG runs from
+ * the ~40 kHz LSI, so the timeout is approximate. Check-ins are timed
+ * by TIM16 counting milliseconds on its own, not by the SysTick tick,
+ * so the SysTick handler can be supervised as well.
+ * 
+ */
+
+#include "watchdog.h"
+
+/* IWDG keys. */
+#define IWDG_KEY_START 0xCCCC
+#define IWDG_KEY_ACCESS 0x5555
+#define IWDG_KEY_FEED 0xAAAA
+
+/* LSI divided by 32 gives 1.25 counts per millisecond. */
+#define IWDG_PRESCALER_32 3
+#define IWDG_COUNTS(ms) ((ms) * 5 / 4)
+
+/// Longest allowed time between check-ins, per client.
+static const uint16_t deadline_ms[WDG_CLIENTS] =
+{
+    50,  /* WDG_TICK, SysTick fires at least every 10 ms */
+    50,  /* WDG_ENGINE, runs every 1 or 10 ms */
+    100  /* WDG_KEYS, runs every 10 ms */
+};
+
+static __IO uint16_t seen[WDG_CLIENTS]; /* TIM16 ms of last check-in */
+
+/** 
+ * Helper function. Returns milliseconds counted by TIM16, wrapping at
+ * 16 bits.
+ * 
+ * @return TIM16 counter
+ */
+static uint16_t watchdog_ms(void)
+{
+    return TIM16->CNT;
+}
+
+unsigned char watchdog_reset_flags(void)
+{
+    unsigned char flags = RCC->CSR >> 24;
+    RCC->CSR |= RCC_CSR_RMVF;
+    return flags;
+}
+
+void watchdog_init(void)
+{
+    unsigned char i;
+
+    /* Free running millisecond counter. */
+    RCC->APB2ENR |= RCC_APB2ENR_TIM16EN;
+    TIM16->PSC = SystemCoreClock / 1000 - 1;
+    TIM16->ARR = 0xFFFF;
+    TIM16->EGR = TIM_EGR_UG;
+    TIM16->CR1 = TIM_CR1_CEN;
+
+    for(i = 0; i < WDG_CLIENTS; i++)
+    {
+        seen[i] = watchdog_ms();
+    }
+
+    /* Do not reset while halted by the debugger. */
+    RCC->APB2ENR |= RCC_APB2ENR_DBGMCUEN;
+    DBGMCU->APB1FZ |= DBGMCU_APB1_FZ_DBG_IWDG_STOP;
+    DBGMCU->APB2FZ |= DBGMCU_APB2_FZ_DBG_TIM16_STOP;
+
+    IWDG->KR = IWDG_KEY_START;
+    IWDG->KR = IWDG_KEY_ACCESS;
+    IWDG->PR = IWDG_PRESCALER_32;
+    IWDG->RLR = IWDG_COUNTS(WATCHDOG_TIMEOUT_MS);
+    while(IWDG->SR != 0);
+    IWDG->KR = IWDG_KEY_FEED;
+}
+
+void watchdog_checkin(unsigned char client)
+{
+    seen[client] = watchdog_ms();
+}
+
+void watchdog_poll(void)
+{
+    uint16_t now = watchdog_ms();
+    unsigned char i;
+    for(i = 0; i < WDG_CLIENTS; i++)
+    {
+        if((uint16_t)(now - seen[i]) > deadline_ms[i])
+        {
+            return; /* starve the watchdog */
+        }
+    }
+    IWDG->KR = IWDG_KEY_FEED;
+}
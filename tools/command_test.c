@@ -0,0 +1,431 @@
+/**
+ * @file   command_test.c
+ * @author Wiktor Gołgowski <wgolgowski@gmail.com>
+ * @date   Fri Oct 23 09:12:40 2026
+ *
+ * @brief  Host test of the command parser. A fake serial port keeps a
+ * receive ring like the DMA one and feeds it the way task_command does,
+ * the transmitter records replies and can be made busy. Run by
+ *
+ *     make check
+ *
+ * Split, wrapped, oversized, bad CRC, retried and broadcast frames are
+ * checked, then random bytes are fed with random chunking and a
+ * randomly busy transmitter. Build with HOSTCC="cc -fsanitize=address,undefined"
+ * to catch out of bounds access.
+ *
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "command.h"
+#include "crc16.h"
+#include "cobs.h"
+
+/* Same size as the firmware ring. */
+#define RING_SIZE 128
+
+#define ADDRESS 17
+
+static unsigned char ring[RING_SIZE];
+static uint16_t ring_head; /* next byte written by the "DMA" */
+static uint16_t ring_tail; /* first unread byte */
+
+static unsigned char tx_ready = 1;
+static unsigned char replies[64][COBS_MAX(COMMAND_FRAME_MAX) + 1];
+static uint16_t reply_len[64];
+static unsigned int reply_count;
+
+static unsigned int runs; /* handler calls */
+static unsigned int failures;
+
+static CommandPort port;
+
+#define CHECK(cond) check((cond), #cond, __LINE__)
+
+static void check(int ok, const char* what, int line)
+{
+    if(!ok)
+    {
+        printf("line %d: %s\n", line, what);
+        failures++;
+    }
+}
+
+static uint16_t ring_unread(void)
+{
+    return (ring_head + RING_SIZE - ring_tail) % RING_SIZE;
+}
+
+static void ring_write(const unsigned char* data, uint16_t len)
+{
+    uint16_t i;
+    for(i = 0; i < len; i++)
+    {
+        CHECK(ring_unread() < RING_SIZE - 1); /* the test itself overflows */
+        ring[ring_head] = data[i];
+        ring_head = (ring_head + 1) % RING_SIZE;
+    }
+}
+
+/* Feeds the ring to the parser, like task_command with serial_peek. */
+static void ring_feed(void)
+{
+    unsigned char i;
+    for(i = 0; i < 2; i++)
+    {
+        uint16_t len = ring_head >= ring_tail ? ring_head - ring_tail : RING_SIZE - ring_tail;
+        uint16_t used = command_feed(&port, &ring[ring_tail], len);
+        CHECK(used <= len);
+        ring_tail = (ring_tail + used) % RING_SIZE;
+        if(used < len || len == 0)
+            break;
+    }
+}
+
+static unsigned char fake_ready(void)
+{
+    return tx_ready;
+}
+
+static unsigned char fake_send(const unsigned char* data, uint16_t len)
+{
+    CHECK(tx_ready);
+    CHECK(len <= sizeof(replies[0]));
+    if(reply_count < sizeof(replies) / sizeof(replies[0]) && len <= sizeof(replies[0]))
+    {
+        memcpy(replies[reply_count], data, len);
+        reply_len[reply_count] = len;
+    }
+    reply_count++;
+    return 1;
+}
+
+static int16_t cmd_echo(const unsigned char* arg, uint16_t len, unsigned char* reply)
+{
+    runs++;
+    if(len > COMMAND_DATA_MAX)
+        return -COMMAND_BAD_LENGTH;
+    memcpy(reply, arg, len);
+    return len;
+}
+
+static int16_t cmd_fail(const unsigned char* arg, uint16_t len, unsigned char* reply)
+{
+    runs++;
+    return -COMMAND_RANGE;
+}
+
+static const Command commands[] =
+{
+    {COMMAND_PING, cmd_echo},
+    {COMMAND_WRITE, cmd_fail}
+};
+
+static void reset(void)
+{
+    command_init(&port, commands, sizeof(commands) / sizeof(commands[0]),
+                 ADDRESS, fake_ready, fake_send);
+    ring_head = ring_tail = 0;
+    tx_ready = 1;
+    reply_count = 0;
+    runs = 0;
+}
+
+/* Encodes a request with its CRC and the ending zero. */
+static uint16_t request(unsigned char* out, unsigned char address, unsigned char code,
+                        const unsigned char* arg, uint16_t len)
+{
+    unsigned char raw[256];
+    raw[0] = address;
+    raw[1] = code;
+    if(len != 0)
+        memcpy(raw + 2, arg, len);
+    uint16_t crc = crc16(CRC16_INIT, raw, len + 2);
+    raw[len + 2] = crc;
+    raw[len + 3] = crc >> 8;
+    uint16_t n = cobs_encode(out, raw, len + 4);
+    out[n++] = 0;
+    return n;
+}
+
+/* Decodes a recorded reply, checks its frame and returns data length. */
+static int reply_data(unsigned int index, unsigned char code, unsigned char* status,
+                      unsigned char* data)
+{
+    unsigned char raw[sizeof(replies[0])];
+    uint16_t len = reply_len[index];
+
+    CHECK(len >= 2 && replies[index][len - 1] == 0);
+    if(len < 2)
+        return -1;
+    uint16_t n = cobs_decode(raw, replies[index], len - 1);
+    CHECK(n >= 5);
+    if(n < 5)
+        return -1;
+    CHECK(crc16(CRC16_INIT, raw, n - 2) == (raw[n-2] | (raw[n-1] << 8)));
+    CHECK(raw[0] == ADDRESS);
+    CHECK(raw[1] == (code | COMMAND_REPLY));
+    *status = raw[2];
+    memcpy(data, raw + 3, n - 5);
+    return n - 5;
+}
+
+static void test_simple(void)
+{
+    unsigned char frame[128], data[128], status;
+    unsigned char arg[] = {1, 0, 2};
+
+    reset();
+    ring_write(frame, request(frame, ADDRESS, COMMAND_PING, arg, sizeof(arg)));
+    ring_feed();
+    CHECK(runs == 1 && reply_count == 1);
+    CHECK(reply_data(0, COMMAND_PING, &status, data) == sizeof(arg));
+    CHECK(status == COMMAND_OK && memcmp(data, arg, sizeof(arg)) == 0);
+    CHECK(port.errors == 0 && ring_unread() == 0);
+}
+
+static void test_split(void)
+{
+    unsigned char frame[128], data[128], status;
+    unsigned char arg[] = {5, 6, 7, 8};
+    uint16_t n, i;
+
+    reset();
+    n = request(frame, ADDRESS, COMMAND_PING, arg, sizeof(arg));
+    for(i = 0; i < n; i++)
+    {
+        ring_write(frame + i, 1);
+        ring_feed();
+        CHECK(reply_count == (i == n - 1));
+    }
+    CHECK(reply_data(0, COMMAND_PING, &status, data) == sizeof(arg));
+    CHECK(status == COMMAND_OK && memcmp(data, arg, sizeof(arg)) == 0);
+}
+
+static void test_wrapped(void)
+{
+    unsigned char frame[128], data[128], status;
+    unsigned char arg[20];
+    uint16_t n, start;
+
+    for(n = 0; n < sizeof(arg); n++)
+        arg[n] = n + 1;
+
+    /* Every position of the wrap inside two back to back frames. */
+    for(start = RING_SIZE - 60; start < RING_SIZE; start++)
+    {
+        reset();
+        ring_head = ring_tail = start;
+        n = request(frame, ADDRESS, COMMAND_PING, arg, sizeof(arg));
+        ring_write(frame, n);
+        ring_write(frame, n);
+        ring_feed();
+        CHECK(reply_count == 2 && runs == 2);
+        CHECK(reply_data(1, COMMAND_PING, &status, data) == sizeof(arg));
+        CHECK(status == COMMAND_OK && memcmp(data, arg, sizeof(arg)) == 0);
+        CHECK(ring_unread() == 0 && port.errors == 0);
+    }
+}
+
+static void test_longest(void)
+{
+    unsigned char frame[128], data[128], status;
+    unsigned char arg[COMMAND_DATA_MAX + 1];
+    uint16_t i;
+
+    for(i = 0; i < sizeof(arg); i++)
+        arg[i] = 0xA0 + i;
+
+    reset();
+    ring_write(frame, request(frame, ADDRESS, COMMAND_PING, arg, COMMAND_DATA_MAX));
+    ring_feed();
+    CHECK(reply_count == 1);
+    CHECK(reply_data(0, COMMAND_PING, &status, data) == COMMAND_DATA_MAX);
+    CHECK(status == COMMAND_OK && memcmp(data, arg, COMMAND_DATA_MAX) == 0);
+
+    /* One byte longer still fits the frame, the handler refuses it. */
+    reset();
+    ring_write(frame, request(frame, ADDRESS, COMMAND_PING, arg, COMMAND_DATA_MAX + 1));
+    ring_feed();
+    CHECK(reply_count == 1 && port.errors == 0);
+    CHECK(reply_data(0, COMMAND_PING, &status, data) == 0 && status == COMMAND_BAD_LENGTH);
+}
+
+static void test_oversized(void)
+{
+    unsigned char frame[128];
+    unsigned char junk[100];
+    uint16_t i;
+
+    reset();
+    memset(junk, 0x55, sizeof(junk));
+    ring_write(junk, sizeof(junk));
+    ring_feed();
+    CHECK(reply_count == 0 && port.errors == 0); /* not ended yet */
+    ring_write(junk, 1);
+    ring_write((const unsigned char*)"", 1);
+    ring_feed();
+    CHECK(reply_count == 0 && runs == 0 && port.errors == 1);
+
+    /* The parser resynchronises on the next zero. */
+    ring_write(frame, request(frame, ADDRESS, COMMAND_PING, junk, 2));
+    ring_feed();
+    CHECK(reply_count == 1 && runs == 1);
+
+    /* Encoded length exactly at the buffer size is still accepted. */
+    reset();
+    for(i = 0; i < sizeof(junk); i++)
+        junk[i] = i + 1;
+    uint16_t n = request(frame, ADDRESS, COMMAND_PING, junk, COMMAND_DATA_MAX + 1);
+    CHECK(n - 1 == sizeof(port.frame));
+    ring_write(frame, n);
+    ring_feed();
+    CHECK(reply_count == 1 && port.errors == 0);
+}
+
+static void test_bad_crc(void)
+{
+    unsigned char frame[128];
+    unsigned char arg[] = {1, 2, 3};
+    uint16_t n, i;
+
+    for(i = 0; i < 4 + sizeof(arg); i++)
+    {
+        reset();
+        n = request(frame, ADDRESS, COMMAND_PING, arg, sizeof(arg));
+        frame[1 + i] ^= 0x10; /* any byte, COBS code bytes included */
+        if(frame[1 + i] == 0)
+            frame[1 + i] = 0x10;
+        ring_write(frame, n);
+        ring_feed();
+        CHECK(reply_count == 0 && runs == 0 && port.errors == 1);
+    }
+
+    /* Too short for address, code and CRC. */
+    reset();
+    ring_write((const unsigned char*)"\x03\x11\x01", 4);
+    ring_feed();
+    CHECK(reply_count == 0 && port.errors == 1);
+
+    /* Empty frames between requests are not errors. */
+    reset();
+    ring_write((const unsigned char*)"\0\0\0", 3);
+    ring_feed();
+    CHECK(reply_count == 0 && port.errors == 0);
+}
+
+static void test_addressing(void)
+{
+    unsigned char frame[128], data[128], status;
+
+    reset();
+    ring_write(frame, request(frame, ADDRESS + 1, COMMAND_PING, 0, 0));
+    ring_feed();
+    CHECK(reply_count == 0 && runs == 0 && port.errors == 0);
+
+    ring_write(frame, request(frame, COMMAND_BROADCAST, COMMAND_PING, 0, 0));
+    ring_feed();
+    CHECK(reply_count == 0 && runs == 1);
+
+    /* Broadcast never waits for the transmitter to reply. */
+    tx_ready = 0;
+    ring_write(frame, request(frame, COMMAND_BROADCAST, COMMAND_WRITE, 0, 0));
+    ring_feed();
+    tx_ready = 1;
+    ring_feed();
+    CHECK(reply_count == 0 && runs == 2);
+
+    reset();
+    ring_write(frame, request(frame, ADDRESS, 0x7F, 0, 0));
+    ring_write(frame, request(frame, ADDRESS, COMMAND_WRITE, 0, 0));
+    ring_feed();
+    CHECK(reply_count == 2 && runs == 1);
+    CHECK(reply_data(0, 0x7F, &status, data) == 0 && status == COMMAND_UNKNOWN);
+    CHECK(reply_data(1, COMMAND_WRITE, &status, data) == 0 && status == COMMAND_RANGE);
+}
+
+static void test_pending(void)
+{
+    unsigned char frame[128], data[128], status;
+    unsigned char first[] = {1}, second[] = {2};
+    uint16_t n2;
+
+    reset();
+    tx_ready = 0;
+    ring_write(frame, request(frame, ADDRESS, COMMAND_PING, first, 1));
+    n2 = request(frame, ADDRESS, COMMAND_PING, second, 1);
+    ring_write(frame, n2);
+    ring_feed();
+    ring_feed();
+    CHECK(reply_count == 0 && runs == 0);
+    CHECK(port.pending == 1);
+    CHECK(ring_unread() == n2); /* the second request stays in the ring */
+
+    tx_ready = 1;
+    ring_feed();
+    CHECK(reply_count == 2 && runs == 2 && port.pending == 0);
+    CHECK(reply_data(0, COMMAND_PING, &status, data) == 1 && data[0] == 1);
+    CHECK(reply_data(1, COMMAND_PING, &status, data) == 1 && data[0] == 2);
+    CHECK(ring_unread() == 0);
+}
+
+static void test_fuzz(void)
+{
+    unsigned char chunk[RING_SIZE];
+    unsigned char frame[128], data[128], status;
+    unsigned long round;
+    unsigned int i;
+
+    reset();
+    srand(1);
+    for(round = 0; round < 200000; round++)
+    {
+        uint16_t n = rand() % (RING_SIZE - 1 - ring_unread() + 1);
+        for(i = 0; i < n; i++)
+        {
+            /* Zeros often enough to end short frames. */
+            chunk[i] = rand() % 8 == 0 ? 0 : rand();
+        }
+        ring_write(chunk, n);
+        tx_ready = rand() % 4 != 0;
+        ring_feed();
+    }
+
+    /* Every reply is a valid frame of this drive. */
+    for(i = 0; i < reply_count && i < sizeof(replies) / sizeof(replies[0]); i++)
+    {
+        unsigned char raw[sizeof(replies[0])];
+        uint16_t n = cobs_decode(raw, replies[i], reply_len[i] - 1);
+        CHECK(n >= 5 && raw[0] == ADDRESS && (raw[1] & COMMAND_REPLY));
+        CHECK(crc16(CRC16_INIT, raw, n - 2) == (raw[n-2] | (raw[n-1] << 8)));
+    }
+
+    /* After the noise a request ended by a zero is answered. */
+    tx_ready = 1;
+    ring_feed();
+    ring_write((const unsigned char*)"", 1);
+    ring_feed();
+    reply_count = 0;
+    ring_write(frame, request(frame, ADDRESS, COMMAND_PING, (const unsigned char*)"ok", 2));
+    ring_feed();
+    CHECK(reply_count == 1);
+    CHECK(reply_data(0, COMMAND_PING, &status, data) == 2 && memcmp(data, "ok", 2) == 0);
+}
+
+int main(void)
+{
+    test_simple();
+    test_split();
+    test_wrapped();
+    test_longest();
+    test_oversized();
+    test_bad_crc();
+    test_addressing();
+    test_pending();
+    test_fuzz();
+
+    printf("command_test: %s\n", failures ? "FAILED" : "ok");
+    return failures != 0;
+}
@@ -0,0 +1,252 @@
+/**
+ * @file   engine_test.c
+ * @author Wiktor Gołgowski <wgolgowski@gmail.com>
+ * @date   Fri Oct 23 10:37:15 2026
+ *
+ * @brief  Host test of the drive state machine. Every (state, event)
+ * pair is checked for its next state and its effect on the drive,
+ * then whole sequences: start and ramp, reversal, a reversal given
+ * up half way and a fault during a reversal. Run by
+ *
+ *     make check
+ *
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include "engine_fsm.h"
+
+static unsigned int failures;
+
+#define CHECK(cond) check((cond), #cond, __LINE__)
+
+static void check(int ok, const char* what, int line)
+{
+    if(!ok)
+    {
+        printf("line %d: %s\n", line, what);
+        failures++;
+    }
+}
+
+/* Next state by state and event, written out independently of the
+ * table in engine_fsm.c. */
+static const unsigned char expected_next[ENGINE_STATES][ENGINE_EVENTS] =
+{
+    /*                   RUN               STOP            REVERSE           FAULT */
+    [ENGINE_INIT]      = {ENGINE_READY,    ENGINE_READY,   ENGINE_READY,     ENGINE_STOPPED},
+    [ENGINE_READY]     = {ENGINE_RUNNING,  ENGINE_READY,   ENGINE_REVERSING, ENGINE_STOPPED},
+    [ENGINE_RUNNING]   = {ENGINE_RUNNING,  ENGINE_READY,   ENGINE_REVERSING, ENGINE_STOPPED},
+    [ENGINE_STOPPED]   = {ENGINE_READY,    ENGINE_READY,   ENGINE_READY,     ENGINE_STOPPED},
+    [ENGINE_REVERSING] = {ENGINE_RUNNING,  ENGINE_READY,   ENGINE_REVERSING, ENGINE_STOPPED}
+};
+
+/* A drive running left at 50 rpm, asked for 100 rpm to the right,
+ * with the next ramp step due. */
+static void running_drive(Engine* e, unsigned char state)
+{
+    memset(e, 0, sizeof(*e));
+    e->state = state;
+    e->direction = 0;
+    e->requested_direction = 1;
+    e->started = 1;
+    e->rotation = 50;
+    e->requested_rotation = 100;
+    e->phase = 3;
+    e->duration = 60000 / (50 * ENGINE_PHASES);
+    e->phase_counter = e->duration;
+    e->pattern = ENGINE_PHASES;
+    e->ramp_counter = ENGINE_RAMP_STEPS - 1;
+}
+
+/* Runs the machine on its own inputs until the condition or a limit. */
+#define RUN_UNTIL(e, cond, limit, steps)                        \
+    for(steps = 0; steps < (limit) && !(cond); steps++)         \
+        engine_handle(e, engine_event(e))
+
+static void test_table(void)
+{
+    unsigned char state, event;
+
+    for(state = 0; state < ENGINE_STATES; state++)
+    {
+        for(event = 0; event < ENGINE_EVENTS; event++)
+        {
+            Engine e, before;
+            running_drive(&e, state);
+            before = e;
+            engine_handle(&e, event);
+            CHECK(e.state == expected_next[state][event]);
+            CHECK(e.phase_counter <= e.duration);
+
+            if(event == ENGINE_EV_FAULT)
+            {
+                /* Any state: outputs off, not started, no setpoint. */
+                CHECK(e.rotation == 0 && e.started == 0 && e.requested_rotation == 0);
+                CHECK(e.reverse.line == 0);
+                continue;
+            }
+
+            switch(state)
+            {
+            case ENGINE_INIT:
+                CHECK(e.rotation == 0 && e.phase == 0 && e.started == 0);
+                CHECK(e.direction == before.requested_direction);
+                CHECK(e.requested_rotation == before.requested_rotation);
+                break;
+
+            case ENGINE_READY:
+            case ENGINE_RUNNING:
+            case ENGINE_REVERSING:
+                if(event == ENGINE_EV_RUN)
+                {
+                    /* One ramp step, period of the new rotation. */
+                    CHECK(e.rotation == before.rotation + 1);
+                    CHECK(e.duration == 60000 / (e.rotation * ENGINE_PHASES));
+                }
+                else if(event == ENGINE_EV_STOP)
+                {
+                    CHECK(e.rotation == 0 && e.started == before.started);
+                    CHECK(e.requested_rotation == before.requested_rotation);
+                }
+                else
+                {
+                    /* Reversal begins: brakes, the setpoint is kept aside. */
+                    CHECK(e.rotation == before.rotation - 1);
+                    CHECK(e.requested_rotation == 0);
+                    CHECK(e.rotation_before_reverse == before.requested_rotation);
+                    CHECK(e.direction == before.direction);
+                }
+                break;
+
+            case ENGINE_STOPPED:
+                /* Only the state changes, START is needed again. */
+                e.state = before.state;
+                CHECK(memcmp(&e, &before, sizeof(e)) == 0);
+                break;
+            }
+        }
+    }
+}
+
+static void test_start(void)
+{
+    Engine e;
+    unsigned int steps;
+
+    memset(&e, 0, sizeof(e));
+    e.requested_rotation = 30;
+    e.requested_direction = 1;
+    engine_handle(&e, engine_event(&e));
+    CHECK(e.state == ENGINE_READY && e.direction == 1 && e.rotation == 0);
+
+    /* Not started: stays ready, the setpoint is kept. */
+    engine_handle(&e, engine_event(&e));
+    CHECK(e.state == ENGINE_READY && e.requested_rotation == 30);
+
+    e.started = 1;
+    RUN_UNTIL(&e, e.rotation == 30, 1000, steps);
+    CHECK(e.state == ENGINE_RUNNING && e.rotation == 30);
+    CHECK(steps == 30 * ENGINE_RAMP_STEPS); /* ramp rate */
+    CHECK(e.duration == 60000 / (30 * ENGINE_PHASES));
+
+    /* STOP coasts, START ramps again from zero. */
+    e.started = 0;
+    engine_handle(&e, engine_event(&e));
+    CHECK(e.state == ENGINE_READY && e.rotation == 0 && e.requested_rotation == 30);
+}
+
+static void test_reverse(void)
+{
+    Engine e;
+    unsigned int steps;
+
+    running_drive(&e, ENGINE_RUNNING);
+    e.requested_direction = e.direction;
+    e.requested_rotation = 50;
+    engine_handle(&e, engine_event(&e));
+    CHECK(e.state == ENGINE_RUNNING && e.rotation == 50);
+
+    e.requested_direction = 1;
+    RUN_UNTIL(&e, e.rotation == 0, 1000, steps);
+    CHECK(steps == (50 - 1) * ENGINE_RAMP_STEPS + 1); /* braking rate */
+    CHECK(e.state == ENGINE_REVERSING && e.direction == 0);
+    CHECK(e.requested_rotation == 0);
+
+    /* At rest the direction flips and the setpoint comes back. */
+    engine_handle(&e, engine_event(&e));
+    CHECK(e.direction == 1 && e.requested_rotation == 50 && e.started == 1);
+    CHECK(e.phase == 0);
+    RUN_UNTIL(&e, e.rotation == 50, 1000, steps);
+    CHECK(e.state == ENGINE_RUNNING && e.rotation == 50 && e.direction == 1);
+}
+
+static void test_cancel(void)
+{
+    Engine e;
+    unsigned int steps;
+
+    running_drive(&e, ENGINE_RUNNING);
+    e.requested_direction = 1;
+    RUN_UNTIL(&e, e.rotation == 20, 1000, steps);
+    CHECK(e.state == ENGINE_REVERSING && e.requested_rotation == 0);
+
+    /* Direction asked back while braking: the setpoint returns and the
+     * drive ramps up again the same way. */
+    e.requested_direction = 0;
+    engine_handle(&e, engine_event(&e));
+    CHECK(e.state == ENGINE_RUNNING && e.requested_rotation == 100);
+    CHECK(e.direction == 0 && e.reverse.line == 0);
+    RUN_UNTIL(&e, e.rotation == 100, 1000, steps);
+    CHECK(e.rotation == 100 && e.state == ENGINE_RUNNING);
+
+    /* Stopped while braking: setpoint kept for the next START. */
+    e.requested_direction = 1;
+    RUN_UNTIL(&e, e.rotation == 60, 1000, steps);
+    e.requested_direction = 0;
+    e.started = 0;
+    engine_handle(&e, engine_event(&e));
+    CHECK(e.state == ENGINE_READY && e.rotation == 0 && e.requested_rotation == 100);
+    CHECK(e.reverse.line == 0);
+}
+
+static void test_fault_in_reverse(void)
+{
+    Engine e;
+    unsigned int steps;
+
+    running_drive(&e, ENGINE_RUNNING);
+    e.requested_direction = 1;
+    RUN_UNTIL(&e, e.rotation == 25, 1000, steps);
+    CHECK(e.state == ENGINE_REVERSING);
+
+    e.fault_overcurrent = 1;
+    engine_handle(&e, ENGINE_EV_FAULT);
+    CHECK(e.state == ENGINE_STOPPED && e.rotation == 0 && e.started == 0);
+    CHECK(e.reverse.line == 0 && e.direction == 0);
+
+    /* Latched fault: the reversal request alone does not restart. */
+    engine_handle(&e, engine_event(&e));
+    CHECK(e.state == ENGINE_READY);
+
+    /* Cleared and started again: a fresh reversal, nothing resumed
+     * from the interrupted one. */
+    e.fault_overcurrent = 0;
+    e.requested_rotation = 40;
+    e.started = 1;
+    RUN_UNTIL(&e, e.direction == 1 && e.rotation == 40, 1000, steps);
+    CHECK(e.direction == 1 && e.rotation == 40 && e.state == ENGINE_RUNNING);
+    CHECK(e.requested_rotation == 40);
+}
+
+int main(void)
+{
+    test_table();
+    test_start();
+    test_reverse();
+    test_cancel();
+    test_fault_in_reverse();
+
+    printf("engine_test: %s\n", failures ? "FAILED" : "ok");
+    return failures != 0;
+}
@@ -0,0 +1,68 @@
+/**
+ * @file   image_crc.c
+ * @author Wiktor Gołgowski <wgolgowski@gmail.com>
+ * @date   Thu Oct 22 11:05:39 2026
+ * 
+ * @brief  Host tool. Writes the CRC-32 of a firmware image into its
+ * last word, the _image_crc word placed there by the linker script.
+ * The firmware checks it at boot, unless the word is 0.
+ *
+ *     tools/image_crc test.bin
+ * 
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include "crc32.h"
+
+int main(int argc, char** argv)
+{
+    if(argc != 2)
+    {
+        fprintf(stderr, "usage: %s image.bin\n", argv[0]);
+        return 2;
+    }
+
+    FILE* f = fopen(argv[1], "r+b");
+    if(f == 0)
+    {
+        perror(argv[1]);
+        return 1;
+    }
+    fseek(f, 0, SEEK_END);
+    long len = ftell(f);
+    if(len < 8 || len % 4 != 0)
+    {
+        fprintf(stderr, "%s: not an image, %ld bytes\n", argv[1], len);
+        fclose(f);
+        return 1;
+    }
+
+    unsigned char* image = malloc(len);
+    rewind(f);
+    if(image == 0 || fread(image, 1, len, f) != (size_t)len)
+    {
+        fprintf(stderr, "%s: read failed\n", argv[1]);
+        fclose(f);
+        return 1;
+    }
+
+    uint32_t crc = crc32(image, len - 4);
+    if(crc == 0)
+    {
+        /* Would read as an unchecked image, rebuild with any change. */
+        fprintf(stderr, "%s: crc is 0, not checkable\n", argv[1]);
+        fclose(f);
+        return 1;
+    }
+    unsigned char out[4] = {crc, crc >> 8, crc >> 16, crc >> 24};
+    fseek(f, len - 4, SEEK_SET);
+    if(fwrite(out, 1, 4, f) != 4 || fclose(f) != 0)
+    {
+        fprintf(stderr, "%s: write failed\n", argv[1]);
+        return 1;
+    }
+    printf("%s: %ld bytes, crc %08lx\n", argv[1], len - 4, (unsigned long)crc);
+    free(image);
+    return 0;
+}
@@ -0,0 +1,91 @@
+/**
+ * @file   telemetry_decode.c
+ * @author Wiktor Gołgowski <wgolgowski@gmail.com>
+ * @date   Tue Oct 20 16:31:08 2026
+ * 
+ * @brief  Host tool. Listens to the command line on stdin and writes
+ * one CSV row per COMMAND_STATS reply to stdout, e.g.
+ *
+ *     stty -F /dev/ttyUSB0 115200 raw && tools/telemetry_decode < /dev/ttyUSB0 > log.csv
+ *
+ * The drives only answer, so the supervisory controller has to poll
+ * them. Other frames are skipped, frames with a bad CRC are counted on
+ * stderr.
+ * 
+ */
+
+#include <stdio.h>
+#include "telemetry.h"
+#include "command.h"
+#include "crc16.h"
+#include "cobs.h"
+
+/* Longest frame accepted, longer ones are garbage. */
+#define FRAME_MAX COBS_MAX(COMMAND_FRAME_MAX)
+
+/* Decoded STATS reply: address, code, status, record, errors, CRC. */
+#define STATS_LEN (3 + TELEMETRY_RECORD_LEN + 2 + 2)
+
+static uint16_t get16(const unsigned char* p)
+{
+    return p[0] | (p[1] << 8);
+}
+
+static void print_record(unsigned char address, const unsigned char* r)
+{
+    printf("%u,%lu,%u,%u,%u,%u,%u,%u,%u,%u,%u,%u,%u,%u,%u,%u\n",
+           address,
+           (unsigned long)get16(r) | ((unsigned long)get16(r + 2) << 16),
+           r[4], r[5],
+           (r[6] & TELEMETRY_FAULT) != 0,
+           (r[6] & TELEMETRY_STARTED) != 0,
+           (r[6] & TELEMETRY_DIRECTION) != 0,
+           r[7],
+           get16(r + 8), get16(r + 10),
+           get16(r + 12), get16(r + 14), get16(r + 16),
+           get16(r + 18), get16(r + 20),
+           get16(r + TELEMETRY_RECORD_LEN));
+}
+
+int main(void)
+{
+    unsigned char frame[FRAME_MAX];
+    unsigned char rec[FRAME_MAX];
+    unsigned int len = 0;
+    unsigned long bad = 0;
+    int c;
+
+    printf("address,time_ms,state,phase,fault,started,direction,idle_percent,"
+           "requested_rpm,rpm,current_u,current_v,current_w,jitter_us,overruns,errors\n");
+
+    while((c = getchar()) != EOF)
+    {
+        if(c != 0)
+        {
+            if(len < FRAME_MAX)
+                frame[len] = c;
+            len++;
+            continue;
+        }
+
+        if(len != 0)
+        {
+            uint16_t n = len <= FRAME_MAX ? cobs_decode(rec, frame, len) : 0;
+            if(n < 4 || crc16(CRC16_INIT, rec, n - 2) != get16(rec + n - 2))
+            {
+                bad++;
+            }
+            else if(n == STATS_LEN && rec[1] == (COMMAND_STATS | COMMAND_REPLY)
+                    && rec[2] == COMMAND_OK)
+            {
+                print_record(rec[0], rec + 3);
+                fflush(stdout);
+            }
+        }
+        len = 0;
+    }
+
+    if(bad != 0)
+        fprintf(stderr, "%lu bad frames\n", bad);
+    return 0;
+}